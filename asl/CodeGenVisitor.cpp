@@ -34,8 +34,14 @@
 #include "../common/SymTable.h"
 #include "../common/TreeDecoration.h"
 #include "../common/code.h"
+#include "../common/Arena.h"
 
 #include <string>
+#include <vector>
+#include <memory>     // std::unique_ptr
+#include <thread>
+#include <atomic>
+#include <algorithm>  // std::min
 #include <cstddef>    // std::size_t
 
 // uncomment the following line to enable debugging messages with DEBUG*
@@ -45,14 +51,22 @@
 // using namespace std;
 
 #define RESULT_ADDRESS "_result"
+#define OUT_OF_RANGE_LABEL "outOfRange"
 
 // Constructor
 CodeGenVisitor::CodeGenVisitor(TypesMgr       & Types,
                                SymTable       & Symbols,
-                               TreeDecoration & Decorations) :
+                               TreeDecoration & Decorations,
+                               unsigned         Jobs,
+                               bool             BoundsCheck,
+                               bool             FuseBranches) :
   Types{Types},
   Symbols{Symbols},
-  Decorations{Decorations} {
+  Decorations{Decorations},
+  Jobs{Jobs},
+  BoundsCheck{BoundsCheck},
+  FuseBranches{FuseBranches},
+  indexChecked{false} {
 }
 
 // Accessor/Mutator to the attribute currFunctionType
@@ -71,9 +85,51 @@ antlrcpp::Any CodeGenVisitor::visitProgram(AslParser::ProgramContext *ctx) {
   code my_code;
   SymTable::ScopeId sc = getScopeDecor(ctx);
   Symbols.pushThisScope(sc);
-  for (auto ctxFunc : ctx->function()) { 
-    subroutine subr = visit(ctxFunc);
-    my_code.add_subroutine(subr);
+  std::vector<AslParser::FunctionContext *> functions = ctx->function();
+  if (Jobs <= 1 or functions.size() <= 1) {
+    for (auto ctxFunc : functions) { 
+      subroutine subr = visit(ctxFunc);
+      my_code.add_subroutine(subr);
+    }
+  }
+  else {
+    // functions are independent: each thread takes the next one not
+    // generated yet, with its own visitor (counters), stack of scopes,
+    // arena and buffer of interned texts, so threads share nothing
+    // but what they only read (symbols, types and decorations, frozen
+    // by now) and need no lock. Subroutines are added in source order
+    // at the end, so the result is the same as in the serial case.
+    unsigned nThreads = std::min<std::size_t>(Jobs, functions.size());
+    std::vector<std::unique_ptr<Arena>> arenas;
+    std::vector<std::unique_ptr<internBuffer>> interns;
+    for (unsigned t = 0; t < nThreads; ++t) {
+      arenas.emplace_back(new Arena);
+      interns.emplace_back(new internBuffer);
+    }
+    std::vector<std::unique_ptr<subroutine>> subrs(functions.size());
+    std::vector<unsigned> generatedBy(functions.size());
+    std::atomic<std::size_t> next(0);
+    auto worker = [&](unsigned t) {
+      ArenaScope arenaScope(*arenas[t]);
+      internScope textScope(*interns[t]);
+      SymTable::ThreadScopes scopes(Symbols);
+      CodeGenVisitor generator(Types, Symbols, Decorations, 1, BoundsCheck, FuseBranches);
+      for (std::size_t i = next++; i < functions.size(); i = next++) {
+        subroutine subr = generator.visit(functions[i]);
+        subrs[i].reset(new subroutine(subr));
+        generatedBy[i] = t;
+      }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < nThreads; ++t) threads.emplace_back(worker, t);
+    worker(0);
+    for (auto & th : threads) th.join();
+    // copied into the arena of the compilation (see arenaAllocator),
+    // with the texts of the operands moved to the unit table
+    for (std::size_t i = 0; i < functions.size(); ++i) {
+      my_code.add_subroutine(*subrs[i]);
+      interns[generatedBy[i]]->globalize(my_code.get_last_subroutine());
+    }
   }
   Symbols.popScope();
   DEBUG_EXIT();
@@ -86,6 +142,7 @@ antlrcpp::Any CodeGenVisitor::visitFunction(AslParser::FunctionContext *ctx) {
   Symbols.pushThisScope(sc);
   subroutine subr(ctx->ID()->getText());
   codeCounters.reset();
+  indexChecked = false;
 
   //Set current function Type
   TypesMgr::TypeId funcType = getTypeDecor(ctx);
@@ -119,6 +176,10 @@ antlrcpp::Any CodeGenVisitor::visitFunction(AslParser::FunctionContext *ctx) {
   //Generate function's instructions
   instructionList && code = visit(ctx->statements());
   code = code || instruction(instruction::RETURN());
+  //Failed index checks stop the program
+  if (indexChecked)
+    code = code || instruction::LABEL(OUT_OF_RANGE_LABEL)
+                || instruction::HALT(code::INDEX_OUT_OF_RANGE);
   subr.set_instructions(code);
   Symbols.popScope();
   DEBUG_EXIT();
@@ -256,29 +317,8 @@ antlrcpp::Any CodeGenVisitor::visitAssignStmt(AslParser::AssignStmtContext *ctx)
 
   //Assignment between arrays (copy all the values from right to left array)
   if (Types.isArrayTy(tid1) and Types.isArrayTy(tid2)) {
-    //Get array size and array element size
-    int arrSizeVal  = (int)Types.getArraySize(tid1);
-    TypesMgr::TypeId elemType = Types.getArrayElemType(tid1);
-    int elemSizeVal = (int)Types.getSizeOfType(elemType);
-
-    //Temporal registers for loop
-    std::string iterator      = "%"+codeCounters.newTEMP();
-    std::string elemSize      = "%"+codeCounters.newTEMP();
-    std::string arrSize       = "%"+codeCounters.newTEMP();
-    std::string condAddr      = "%"+codeCounters.newTEMP();
-    std::string temp          = "%"+codeCounters.newTEMP();
-
-    //instruction lists for conditional expression and body statements
-    instructionList condCode  = instruction::LT(condAddr, iterator, arrSize);
-    instructionList bodyStmts = instruction::LOADX(temp, addr2, iterator)
-                             || instruction::XLOAD(addr1, iterator, temp)
-                             || instruction::ADD(iterator, iterator, elemSize);
-
-    //Assemble the entire loop code
-    code = code || instruction::ILOAD(iterator, "0")
-                || instruction::ILOAD(elemSize, std::to_string(elemSizeVal))
-                || instruction::ILOAD(arrSize, std::to_string(arrSizeVal))
-                || instruction_LOOP(condCode, condAddr, bodyStmts);
+    int arrSizeVal = (int)Types.getArraySize(tid1);
+    code = code || instruction::BCOPY(addr1, addr2, std::to_string(arrSizeVal));
   }
   //Otherwise it's a single value
   else {
@@ -304,29 +344,29 @@ antlrcpp::Any CodeGenVisitor::visitAssignStmt(AslParser::AssignStmtContext *ctx)
 antlrcpp::Any CodeGenVisitor::visitIfStmt(AslParser::IfStmtContext *ctx) {
   DEBUG_ENTER();
   instructionList code;
-  CodeAttribs     && codAtsExpr = visit(ctx->expr());
-  std::string          addrExpr = codAtsExpr.addr;
-  instructionList &    codeExpr = codAtsExpr.code;
+  std::string label = codeCounters.newLabelIF();
+  std::string labelEndIf = "endif"+label;
+  std::string labelElse  = "else"+label;
+
+  //The condition jumps to the else part (or to the end) when false
+  instructionList &&   codeExpr = instruction_COND(ctx->expr(), false,
+                                                   ctx->statements(1) ? labelElse : labelEndIf);
 
   //If statements
   instructionList &&   codeStmtsIf = visit(ctx->statements(0));
-  std::string label = codeCounters.newLabelIF();
-  std::string labelEndIf = "endif"+label;
   
   if (ctx->statements(1)) {
     //There's an "else" too
     instructionList &&   codeStmtsElse = visit(ctx->statements(1));
-    std::string labelElse = "else"+label;
 
-    code = codeExpr    || instruction::FJUMP(addrExpr, labelElse) 
+    code = codeExpr
         || codeStmtsIf || instruction::UJUMP(labelEndIf) 
         || instruction::LABEL(labelElse) || codeStmtsElse
         || instruction::LABEL(labelEndIf);
   } 
   else {
     //There's just an "if"
-    code = codeExpr    || instruction::FJUMP(addrExpr, labelEndIf) ||
-           codeStmtsIf || instruction::LABEL(labelEndIf);
+    code = codeExpr || codeStmtsIf || instruction::LABEL(labelEndIf);
   }
   DEBUG_EXIT();
   return code;
@@ -334,12 +374,19 @@ antlrcpp::Any CodeGenVisitor::visitIfStmt(AslParser::IfStmtContext *ctx) {
 
 antlrcpp::Any CodeGenVisitor::visitWhileStmt(AslParser::WhileStmtContext *ctx) {
   DEBUG_ENTER();
-  CodeAttribs     &&  codAtE = visit(ctx->expr());
-  std::string          addrE = codAtE.addr;
-  instructionList &    codeE = codAtE.code;
+  std::string label = codeCounters.newLabelWHILE();
+  std::string labelWhile    = "while" + label;
+  std::string labelEndWhile = "endwhile" + label;
+
+  //The condition leaves the loop when false
+  instructionList &&   codeE = instruction_COND(ctx->expr(), false, labelEndWhile);
   instructionList &&   codeS = visit(ctx->statements());
 
-  instructionList code = instruction_LOOP(codeE, addrE, codeS);
+  instructionList code = instruction::LABEL(labelWhile)
+                      || codeE
+                      || codeS
+                      || instruction::UJUMP(labelWhile)
+                      || instruction::LABEL(labelEndWhile);
   DEBUG_EXIT();
   return code;
 }
@@ -431,17 +478,29 @@ antlrcpp::Any CodeGenVisitor::visitArithmetic(AslParser::ArithmeticContext *ctx)
 
 antlrcpp::Any CodeGenVisitor::visitLogical(AslParser::LogicalContext *ctx) {
   DEBUG_ENTER();
-  CodeAttribs     && codAt1 = visit(ctx->expr(0));
-  std::string         addr1 = codAt1.addr;
-  instructionList &   code1 = codAt1.code;
-  CodeAttribs     && codAt2 = visit(ctx->expr(1));
-  std::string         addr2 = codAt2.addr;
-  instructionList &   code2 = codAt2.code;
-  instructionList &&   code = code1 || code2;
-  
   std::string temp = "%"+codeCounters.newTEMP();
-  if (ctx->AND()) code = code || instruction::AND(temp, addr1, addr2);
-  else            code = code || instruction::OR (temp, addr1, addr2);
+  instructionList code;
+  if (hasEffects(ctx->expr(1))) {
+    //The right operand must be skipped when the left one decides
+    std::string labelFalse = "cond"+codeCounters.newLabelCOND();
+    std::string labelEnd   = "cond"+codeCounters.newLabelCOND();
+    code = instruction_COND(ctx, false, labelFalse)
+        || instruction::ILOAD(temp, "1") || instruction::UJUMP(labelEnd)
+        || instruction::LABEL(labelFalse) || instruction::ILOAD(temp, "0")
+        || instruction::LABEL(labelEnd);
+  }
+  else {
+    //Evaluating both operands is cheaper than jumping
+    CodeAttribs     && codAt1 = visit(ctx->expr(0));
+    std::string         addr1 = codAt1.addr;
+    instructionList &   code1 = codAt1.code;
+    CodeAttribs     && codAt2 = visit(ctx->expr(1));
+    std::string         addr2 = codAt2.addr;
+    instructionList &   code2 = codAt2.code;
+    code = code1 || code2;
+    if (ctx->AND()) code = code || instruction::AND(temp, addr1, addr2);
+    else            code = code || instruction::OR (temp, addr1, addr2);
+  }
   CodeAttribs codAts(temp, "", code);
   DEBUG_EXIT();
   return codAts;
@@ -471,38 +530,8 @@ antlrcpp::Any CodeGenVisitor::visitUnary(AslParser::UnaryContext *ctx) {
 
 antlrcpp::Any CodeGenVisitor::visitRelational(AslParser::RelationalContext *ctx) {
   DEBUG_ENTER();
-  CodeAttribs     && codAt1 = visit(ctx->expr(0));
-  std::string         addr1 = codAt1.addr;
-  instructionList &   code1 = codAt1.code;
-  CodeAttribs     && codAt2 = visit(ctx->expr(1));
-  std::string         addr2 = codAt2.addr;
-  instructionList &   code2 = codAt2.code;
-  instructionList &&   code = code1 || code2;
-
-  TypesMgr::TypeId t1 = getTypeDecor(ctx->expr(0));
-  TypesMgr::TypeId t2 = getTypeDecor(ctx->expr(1));
-  // TypesMgr::TypeId  t = getTypeDecor(ctx);
-
   std::string temp = "%"+codeCounters.newTEMP();
-  if (Types.isFloatTy(t1) or Types.isFloatTy(t2)) {
-    //Must coerce to float type
-    std::string param1 = coerceType(code, t2, t1, addr1);
-    std::string param2 = coerceType(code, t1, t2, addr2);
-    if      (ctx->LT())  code = code || instruction::FLT(temp, param1, param2);
-    else if (ctx->LE())  code = code || instruction::FLE(temp, param1, param2);
-    else if (ctx->GT())  code = code || instruction::FLT(temp, param2, param1);
-    else if (ctx->GE())  code = code || instruction::FLE(temp, param2, param1);
-    else if (ctx->NEQ()) code = code || instruction_FNE(temp, param1, param2);
-    else                 code = code || instruction::FEQ(temp, param1, param2);
-  }
-  else { //Both t1 and t2 must be integer
-    if      (ctx->LT())  code = code || instruction::LT(temp, addr1, addr2);
-    else if (ctx->LE())  code = code || instruction::LE(temp, addr1, addr2);
-    else if (ctx->GT())  code = code || instruction::LT(temp, addr2, addr1);
-    else if (ctx->GE())  code = code || instruction::LE(temp, addr2, addr1);
-    else if (ctx->NEQ()) code = code || instruction_NE(temp, addr1, addr2);
-    else                 code = code || instruction::EQ(temp, addr1, addr2);
-  }
+  instructionList && code = instruction_REL(ctx, temp, false);
   CodeAttribs codAts(temp, "", code);
   DEBUG_EXIT();
   return codAts;
@@ -565,9 +594,13 @@ antlrcpp::Any CodeGenVisitor::visitArrLeftExpr(AslParser::ArrLeftExprContext *ct
   TypesMgr::TypeId  elemType = getTypeDecor(ctx);
   std::size_t       elemSize = Types.getSizeOfType(elemType);
 
-  instructionList code = codeId || codeEx
-                    || instruction::ILOAD(temp1, std::to_string(elemSize))
-                    || instruction::MUL(temp2, addrEx, temp1);
+  instructionList code = codeId || codeEx;
+  if (BoundsCheck) {
+    TypesMgr::TypeId arrType = getTypeDecor(ctx->ident());
+    code = code || instruction_CHECK(addrEx, Types.getArraySize(arrType));
+  }
+  code = code || instruction::ILOAD(temp1, std::to_string(elemSize))
+              || instruction::MUL(temp2, addrEx, temp1);
   CodeAttribs codAts = CodeAttribs(addrId, temp2, code);
 
   DEBUG_EXIT();
@@ -637,6 +670,23 @@ std::string CodeGenVisitor::dereference(instructionList &code,
   return srcAddr;
 }
 
+//Index check
+instructionList CodeGenVisitor::instruction_CHECK(const std::string &index,
+                                                  unsigned int size) {
+  std::string temp1 = "%" + codeCounters.newTEMP();
+  std::string temp2 = "%" + codeCounters.newTEMP();
+  std::string temp3 = "%" + codeCounters.newTEMP();
+  std::string temp4 = "%" + codeCounters.newTEMP();
+  std::string temp5 = "%" + codeCounters.newTEMP();
+  indexChecked = true;
+  return instruction::ILOAD(temp1, "0")
+      || instruction::LE(temp2, temp1, index)
+      || instruction::ILOAD(temp3, std::to_string(size))
+      || instruction::LT(temp4, index, temp3)
+      || instruction::AND(temp5, temp2, temp4)
+      || instruction::FJUMP(temp5, OUT_OF_RANGE_LABEL);
+}
+
 //Modulo
 instructionList CodeGenVisitor::instruction_MOD(const std::string &dest, 
                                                 const std::string &param1, 
@@ -666,19 +716,163 @@ instructionList CodeGenVisitor::instruction_FNE(const std::string &dest,
       || instruction::NOT(dest, temp);
 }
 
-//General loops
-instructionList CodeGenVisitor::instruction_LOOP(instructionList &condCode,
-                                                 const std::string &condAddr,
-                                                 instructionList &bodyStmts) {
-  std::string label = codeCounters.newLabelWHILE();
-  std::string labelWhile    = "while" + label;
-  std::string labelEndWhile = "endwhile" + label;
-  return instruction::LABEL(labelWhile) 
-      || condCode 
-      || instruction::FJUMP(condAddr, labelEndWhile) 
-      || bodyStmts 
-      || instruction::UJUMP(labelWhile) 
-      || instruction::LABEL(labelEndWhile);
+//Jumping code for a condition
+instructionList CodeGenVisitor::instruction_COND(AslParser::ExprContext *ctx,
+                                                 bool jumpWhen,
+                                                 const std::string &label) {
+  if (auto par = dynamic_cast<AslParser::ParenthesisContext *>(ctx))
+    return instruction_COND(par->expr(), jumpWhen, label);
+
+  if (auto un = dynamic_cast<AslParser::UnaryContext *>(ctx))
+    if (un->NOT()) return instruction_COND(un->expr(), not jumpWhen, label);
+
+  if (auto lg = dynamic_cast<AslParser::LogicalContext *>(ctx)) {
+    bool isAnd = lg->AND() != nullptr;
+    //"a and b" is false (and "a or b" true) as soon as one operand is
+    if (isAnd != jumpWhen)
+      return instruction_COND(lg->expr(0), jumpWhen, label)
+          || instruction_COND(lg->expr(1), jumpWhen, label);
+    //otherwise the left operand can only decide to skip the right one
+    std::string labelSkip = "cond"+codeCounters.newLabelCOND();
+    return instruction_COND(lg->expr(0), not jumpWhen, labelSkip)
+        || instruction_COND(lg->expr(1), jumpWhen, label)
+        || instruction::LABEL(labelSkip);
+  }
+
+  if (auto val = dynamic_cast<AslParser::ValueContext *>(ctx))
+    if (val->BOOLVAL()) {
+      if ((val->getText() == "true") == jumpWhen) return instruction::UJUMP(label);
+      return instructionList();
+    }
+
+  //Any other condition is computed, negated when the jump is on true
+  instructionList code;
+  std::string temp;
+  if (auto rel = dynamic_cast<AslParser::RelationalContext *>(ctx)) {
+    if (FuseBranches) return instruction_BRANCH(rel, jumpWhen, label);
+    temp = "%"+codeCounters.newTEMP();
+    code = instruction_REL(rel, temp, jumpWhen);
+  }
+  else {
+    CodeAttribs     && codAts = visit(ctx);
+    code = codAts.code;
+    temp = codAts.addr;
+    if (jumpWhen) {
+      temp = "%"+codeCounters.newTEMP();
+      code = code || instruction::NOT(temp, codAts.addr);
+    }
+  }
+  return code || instruction::FJUMP(temp, label);
+}
+
+//Comparison (or its negation) stored in dest
+instructionList CodeGenVisitor::instruction_REL(AslParser::RelationalContext *ctx,
+                                                const std::string &dest,
+                                                bool negated) {
+  CodeAttribs     && codAt1 = visit(ctx->expr(0));
+  std::string         addr1 = codAt1.addr;
+  instructionList &   code1 = codAt1.code;
+  CodeAttribs     && codAt2 = visit(ctx->expr(1));
+  std::string         addr2 = codAt2.addr;
+  instructionList &   code2 = codAt2.code;
+  instructionList &&   code = code1 || code2;
+
+  TypesMgr::TypeId t1 = getTypeDecor(ctx->expr(0));
+  TypesMgr::TypeId t2 = getTypeDecor(ctx->expr(1));
+
+  if (Types.isFloatTy(t1) or Types.isFloatTy(t2)) {
+    //Must coerce to float type. Comparisons with NaN are always
+    //false, so the negation needs a NOT
+    std::string param1 = coerceType(code, t2, t1, addr1);
+    std::string param2 = coerceType(code, t1, t2, addr2);
+    std::string temp = negated ? "%"+codeCounters.newTEMP() : dest;
+    if      (ctx->LT())  code = code || instruction::FLT(temp, param1, param2);
+    else if (ctx->LE())  code = code || instruction::FLE(temp, param1, param2);
+    else if (ctx->GT())  code = code || instruction::FLT(temp, param2, param1);
+    else if (ctx->GE())  code = code || instruction::FLE(temp, param2, param1);
+    else if (ctx->NEQ()) code = code || instruction_FNE(temp, param1, param2);
+    else                 code = code || instruction::FEQ(temp, param1, param2);
+    if (negated) code = code || instruction::NOT(dest, temp);
+  }
+  else if (not negated) { //Both t1 and t2 must be integer
+    if      (ctx->LT())  code = code || instruction::LT(dest, addr1, addr2);
+    else if (ctx->LE())  code = code || instruction::LE(dest, addr1, addr2);
+    else if (ctx->GT())  code = code || instruction::LT(dest, addr2, addr1);
+    else if (ctx->GE())  code = code || instruction::LE(dest, addr2, addr1);
+    else if (ctx->NEQ()) code = code || instruction_NE(dest, addr1, addr2);
+    else                 code = code || instruction::EQ(dest, addr1, addr2);
+  }
+  else { //Integer comparisons are negated swapping the operands
+    if      (ctx->LT())  code = code || instruction::LE(dest, addr2, addr1);
+    else if (ctx->LE())  code = code || instruction::LT(dest, addr2, addr1);
+    else if (ctx->GT())  code = code || instruction::LE(dest, addr1, addr2);
+    else if (ctx->GE())  code = code || instruction::LT(dest, addr1, addr2);
+    else if (ctx->NEQ()) code = code || instruction::EQ(dest, addr1, addr2);
+    else                 code = code || instruction_NE(dest, addr1, addr2);
+  }
+  return code;
+}
+
+//Compare-and-branch on a comparison
+instructionList CodeGenVisitor::instruction_BRANCH(AslParser::RelationalContext *ctx,
+                                                   bool jumpWhen,
+                                                   const std::string &label) {
+  CodeAttribs     && codAt1 = visit(ctx->expr(0));
+  std::string         addr1 = codAt1.addr;
+  instructionList &   code1 = codAt1.code;
+  CodeAttribs     && codAt2 = visit(ctx->expr(1));
+  std::string         addr2 = codAt2.addr;
+  instructionList &   code2 = codAt2.code;
+  instructionList &&   code = code1 || code2;
+
+  TypesMgr::TypeId t1 = getTypeDecor(ctx->expr(0));
+  TypesMgr::TypeId t2 = getTypeDecor(ctx->expr(1));
+  bool isFloat = Types.isFloatTy(t1) or Types.isFloatTy(t2);
+  if (isFloat) {
+    addr1 = coerceType(code, t2, t1, addr1);
+    addr2 = coerceType(code, t1, t2, addr2);
+  }
+
+  //"a > b" is "b < a", and "a >= b" is "b <= a"
+  instruction::Operation rel;
+  if      (ctx->LT() or ctx->GT()) rel = isFloat ? instruction::_FLT : instruction::_LT;
+  else if (ctx->LE() or ctx->GE()) rel = isFloat ? instruction::_FLE : instruction::_LE;
+  else                             rel = isFloat ? instruction::_FEQ : instruction::_EQ;
+  if (ctx->GT() or ctx->GE()) std::swap(addr1, addr2);
+  //The instruction jumps when the comparison is false, so it tests
+  //the negation to jump when it is true. Integer < and <= are
+  //negated swapping the operands
+  bool negated = (ctx->NEQ() != nullptr) != jumpWhen;
+  if (negated and (rel == instruction::_LT or rel == instruction::_LE)) {
+    rel = (rel == instruction::_LT ? instruction::_LE : instruction::_LT);
+    std::swap(addr1, addr2);
+    negated = false;
+  }
+  instruction::Operation op = instruction::branch_on(rel, negated);
+  if (op != instruction::_INVALID)
+    return code || instruction(op, operand::parse(addr1), operand::parse(addr2),
+                               operand(operand::_LABEL, label));
+
+  //Comparisons with NaN are always false, so the negation of a
+  //float < or <= needs a NOT
+  std::string temp    = "%"+codeCounters.newTEMP();
+  std::string tempNot = "%"+codeCounters.newTEMP();
+  return code
+      || instruction(rel, temp, addr1, addr2)
+      || instruction::NOT(tempNot, temp)
+      || instruction::FJUMP(tempNot, label);
+}
+
+//Calls, array reads and divisions
+bool CodeGenVisitor::hasEffects(antlr4::tree::ParseTree *tree) const {
+  if (dynamic_cast<AslParser::CallContext *>(tree) or
+      dynamic_cast<AslParser::ArrLeftExprContext *>(tree))
+    return true;
+  if (auto ar = dynamic_cast<AslParser::ArithmeticContext *>(tree))
+    if (ar->DIV() or ar->MOD()) return true;
+  for (auto child : tree->children)
+    if (hasEffects(child)) return true;
+  return false;
 }
 
 // Constructors of the class CodeAttribs:
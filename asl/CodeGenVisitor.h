@@ -57,10 +57,18 @@ class CodeGenVisitor final : public AslBaseVisitor {
 
 public:
 
-  // Constructor
+  // Constructor. Functions are generated by Jobs threads (each one
+  // with its own visitor); the result does not depend on Jobs. With
+  // BoundsCheck, every index is checked against the size of its array
+  // before the access (see instruction_CHECK). With FuseBranches, the
+  // comparisons that only decide a jump are compare-and-branch
+  // instructions (see instruction_BRANCH).
   CodeGenVisitor(TypesMgr       & Types,
                  SymTable       & Symbols,
-                 TreeDecoration & Decorations);
+                 TreeDecoration & Decorations,
+                 unsigned         Jobs = 1,
+                 bool             BoundsCheck = false,
+                 bool             FuseBranches = false);
 
   // Methods to visit each kind of node:
   antlrcpp::Any visitProgram(AslParser::ProgramContext *ctx);
@@ -97,6 +105,11 @@ private:
   SymTable        & Symbols;
   TreeDecoration  & Decorations;
   counters          codeCounters;
+  unsigned          Jobs;
+  bool              BoundsCheck;
+  bool              FuseBranches;
+  // true if some index of the current function is checked
+  bool              indexChecked;
   // Current function type (assigned before visit its instructions)
   TypesMgr::TypeId currFunctionType;
 
@@ -124,6 +137,10 @@ private:
   std::string dereference(instructionList &code,
                           std::string &srcAddr);
 
+  //Index check: jump to OUT_OF_RANGE_LABEL unless 0 <= index < size
+  instructionList instruction_CHECK(const std::string &index,
+                                    unsigned int size);
+
   //Modulo
   instructionList instruction_MOD(const std::string &dest,
                                   const std::string &param1,
@@ -136,10 +153,25 @@ private:
   instructionList instruction_FNE(const std::string &dest,
                                   const std::string &addr1,
                                   const std::string &addr2);
-  //General loops
-  instructionList instruction_LOOP(instructionList &condCode,
-                                   const std::string &condAddr,
-                                   instructionList &bodyStmts);
+  //Jumping code for a condition: jumps to label when the condition
+  //is jumpWhen, and falls through otherwise. The operands of and/or
+  //are evaluated only while the result is not known
+  instructionList instruction_COND(AslParser::ExprContext *ctx,
+                                   bool jumpWhen,
+                                   const std::string &label);
+  //Comparison (or its negation, without computing it first) stored
+  //in dest
+  instructionList instruction_REL(AslParser::RelationalContext *ctx,
+                                  const std::string &dest,
+                                  bool negated);
+  //Compare-and-branch: jumps to label when the comparison is
+  //jumpWhen, and falls through otherwise
+  instructionList instruction_BRANCH(AslParser::RelationalContext *ctx,
+                                     bool jumpWhen,
+                                     const std::string &label);
+  //True if evaluating the expression may call, read an array or
+  //divide (and so it cannot be evaluated when it is not needed)
+  bool hasEffects(antlr4::tree::ParseTree *tree) const;
 
   //////////////////////////////////////////////////////////////////
   // Class CodeAttribs: is declared inside CodeGenVisitor as an
@@ -94,3 +94,119 @@ for f in ../examples/jp_genc_*.asl; do
 done
 echo "=== END examples/jp_genc_* codegen ===================="
 echo "======================================================="
+
+########### check all 'jp_opt' examples, with the optimizations on
+echo ""
+echo "======================================================="
+echo "=== BEGIN examples/jp_opt_* optimized codegen ========="
+for opts in "-O1" "-O2 --pass-stats" "-O2 --bounds-check" "-O2 --passes=-inline,-unroll-loops"; do
+    for f in ../examples/jp_opt_[0-9]*.asl; do
+	echo -n "****" $(basename "$f") "[$opts] ...."
+	./asl $opts "$f" >tmp.t 2>tmp.stats
+	if (test $? != 0); then
+	    echo "Compilation errors"
+	else
+	    ../tvm/tvm tmp.t < "${f/asl/in}" >tmp.out
+	    check_genc_example "${f/asl/out}" tmp.out
+	fi
+	rm -f tmp.t tmp.stats tmp.out tmp.diff
+    done
+done
+echo "=== END examples/jp_opt_* optimized codegen ==========="
+echo "======================================================="
+
+########### check that the 'jp_opt' examples compile with compare-and-branch
+########### instructions where jumps are left (the VM in tvm/ cannot run
+########### them, so only the code is checked)
+echo ""
+echo "======================================================="
+echo "=== BEGIN examples/jp_opt_* fused branches ============"
+for f in ../examples/jp_opt_[0-9]*.asl; do
+    echo -n "****" $(basename "$f") "[-O2 --passes=+fuse-branches] ...."
+    ./asl -O2 --passes=+fuse-branches "$f" >tmp.t 2>&1
+    if (test $? != 0); then
+	echo "Compilation errors"
+	cat tmp.t
+    elif grep -q "ifFalse" tmp.t && ! grep -Eq "ifFalse [^ ]+ (<|<=|==|!=)\.? [^ ]+ goto" tmp.t; then
+	echo "No fused branches"
+    else
+	echo "OK"
+    fi
+    rm -f tmp.t
+done
+echo "=== END examples/jp_opt_* fused branches =============="
+echo "======================================================="
+
+########### check the 'jp_opt_halt' examples: an index goes out of range,
+########### so the checked code must halt after the expected output
+echo ""
+echo "======================================================="
+echo "=== BEGIN examples/jp_opt_halt_* index checks ========="
+for opts in "-O0" "-O2"; do
+    for f in ../examples/jp_opt_halt_*.asl; do
+	echo -n "****" $(basename "$f") "[$opts --bounds-check] ...."
+	./asl $opts --bounds-check "$f" >tmp.t 2>tmp.stats
+	if (test $? != 0); then
+	    echo "Compilation errors"
+	else
+	    ../tvm/tvm tmp.t < "${f/asl/in}" >tmp.out 2>tmp.err
+	    if (test $? == 0) || ! grep -q "Container index out of range." tmp.err; then
+		echo "Did not halt"
+		cat tmp.err
+	    else
+		check_genc_example "${f/asl/out}" tmp.out
+	    fi
+	fi
+	rm -f tmp.t tmp.stats tmp.out tmp.err tmp.diff
+    done
+done
+echo "=== END examples/jp_opt_halt_* index checks ==========="
+echo "======================================================="
+
+########### check the 'jp_genc' and 'jp_opt' examples through the binary
+########### t-code: written at -O0, loaded back and optimized
+echo ""
+echo "======================================================="
+echo "=== BEGIN examples/jp_{genc,opt}_* binary round trip =="
+for f in ../examples/jp_genc_*.asl ../examples/jp_opt_[0-9]*.asl; do
+    echo -n "****" $(basename "$f") "...."
+    ./asl --emit-binary "$f" >tmp.tvb 2>&1
+    if (test $? != 0); then
+	echo "Compilation errors"
+    else
+	./asl -O2 --load tmp.tvb >tmp.t 2>&1
+	if (test $? != 0); then
+	    echo "Load errors"
+	    cat tmp.t
+	else
+	    ../tvm/tvm tmp.t < "${f/asl/in}" >tmp.out
+	    check_genc_example "${f/asl/out}" tmp.out
+	fi
+    fi
+    rm -f tmp.tvb tmp.t tmp.out tmp.diff
+done
+echo "=== END examples/jp_{genc,opt}_* binary round trip ===="
+echo "======================================================="
+
+########### check that the code of every example is the same when the
+########### functions are generated by several threads
+echo ""
+echo "======================================================="
+echo "=== BEGIN examples/* parallel codegen ================="
+for opts in "" "-O2"; do
+    for f in ../examples/*.asl; do
+	echo -n "****" $(basename "$f") "[--jobs=4 $opts] ...."
+	./asl --jobs=1 $opts "$f" >tmp.t1 2>&1
+	./asl --jobs=4 $opts "$f" >tmp.t4 2>&1
+	if (cmp -s tmp.t1 tmp.t4); then
+	    echo "OK"
+	else
+	    echo "Different output than with --jobs=1"
+	    diff tmp.t1 tmp.t4 | head -20
+	    echo ""
+	fi
+	rm -f tmp.t1 tmp.t4
+    done
+done
+echo "=== END examples/* parallel codegen ==================="
+echo "======================================================="
@@ -41,10 +41,31 @@
 #include "SymbolsVisitor.h"
 #include "TypeCheckVisitor.h"
 #include "../common/code.h"
+#include "../common/CodeSerializer.h"
+#include "../common/Arena.h"
+#include "../common/BoundsCheck.h"
+#include "../common/BranchFusion.h"
+#include "../common/TailRecursion.h"
+#include "../common/LoopUnroll.h"
+#include "../common/Inliner.h"
+#include "../common/DeadFunctions.h"
+#include "../common/ConstFold.h"
+#include "../common/ValueNumbering.h"
+#include "../common/LoopInvariant.h"
+#include "../common/StrengthReduce.h"
+#include "../common/CopyProp.h"
+#include "../common/DeadCode.h"
+#include "../common/CFGSimplify.h"
+#include "../common/TempAlloc.h"
+#include "../common/PassManager.h"
+#include "../common/BlockCopy.h"
 #include "CodeGenVisitor.h"
 
 #include <iostream>
 #include <fstream>    // ifstream
+#include <string>
+#include <thread>     // hardware_concurrency
+#include <algorithm>  // std::max
 
 #include <cstdio>     // fopen
 #include <cstdlib>    // EXIT_FAILURE, EXIT_SUCCESS
@@ -54,30 +75,176 @@
 // using namespace antlr4;
 
 
+// the t-code passes, in the order they run, with the lowest -O level
+// that enables them
+static void addPasses(PassManager &passes, const std::size_t &inlineThreshold,
+                      const unsigned &unrollFactor, const bool &passStats) {
+  // turn the self tail calls into jumps (before inlining, which
+  // leaves recursive calls alone)
+  passes.add("eliminate-tail-recursion", 2, PassManager::each_subroutine(TailRecursion::run));
+  // replace the calls to small subroutines by their bodies
+  passes.add("inline", 2, [&inlineThreshold](code &c) {
+      return Inliner::run(c, inlineThreshold);
+    });
+  // remove the subroutines that can not be called from main
+  passes.add("remove-dead-functions", 1, DeadFunctions::run);
+  // copy the body of the loops with a constant trip count
+  passes.add("unroll-loops", 2, PassManager::each_subroutine([&unrollFactor](subroutine &s) {
+        return LoopUnroll::run(s, unrollFactor);
+      }));
+  // remove the index checks (see --bounds-check) that can be proved
+  // to never fail
+  passes.add("remove-bounds-checks", 1, PassManager::each_subroutine(BoundsCheck::run));
+  // fold the computations whose result is known at compile time
+  passes.add("fold-constants", 1, PassManager::each_subroutine(ConstFold::run));
+  // remove the computations repeated inside a basic block
+  passes.add("number-values", 1, PassManager::each_subroutine(ValueNumbering::run));
+  // move out of the loops what they compute in every iteration
+  passes.add("hoist-invariants", 2, PassManager::each_subroutine(LoopInvariant::run));
+  // replace the products of induction variables in loops by additions
+  passes.add("reduce-strength", 2, PassManager::each_subroutine(StrengthReduce::run));
+  // replace the copies by their sources
+  passes.add("propagate-copies", 1, PassManager::each_subroutine(CopyProp::run));
+  // remove the instructions whose results are never used
+  passes.add("remove-dead-code", 1, PassManager::each_subroutine(DeadCode::run));
+  // thread the jumps through jumps, merge the blocks and remove the
+  // labels left over, and invert the branches that jump over a goto
+  passes.add("simplify-cfg", 1, PassManager::each_subroutine(CFGSimplify::run));
+  // fuse the comparisons with the jumps they decide (also done by
+  // the code generator). Only on request: the VM in tvm/ does not
+  // know the compare-and-branch instructions
+  passes.add("fuse-branches", 0, PassManager::each_subroutine(BranchFusion::run));
+  // reuse the temporals whose lifetimes do not overlap (changes are
+  // the frame slots saved; with --pass-stats, reported per function)
+  passes.add("pack-temps", 2, PassManager::each_subroutine([&passStats](subroutine &s) {
+        TempAlloc::stats st = TempAlloc::pack(s);
+        if (passStats) st.print(std::cerr);
+        return st.saved();
+      }));
+}
+
+// optimize the code and print it (as text, or in the binary format
+// that can be mapped without parsing, see CodeSerializer.h)
+static void optimizeAndPrint(code &mycode, PassManager &passes, Arena &arena,
+                             bool passStats, bool emitBinary) {
+  passes.run(mycode, &arena);
+  if (passStats) passes.print_stats(std::cerr);
+
+  arena.begin_phase("output");
+  // the VM has no block copy instruction: expand them into loops
+  BlockCopy::expand(mycode);
+  if (emitBinary)
+    CodeSerializer::write(mycode, std::cout);
+  else
+    std::cout << mycode.dump() << std::endl;
+  arena.end_phase();
+}
+
+static int usage(const PassManager &passes) {
+  std::cout << "Usage: ./asl [--onlySyntax|--noCodegen|--load] [--emit-binary] [--mem-stats] [--bounds-check] [-O0|-O1|-O2] [--passes=[+|-]<pass>,...] [--pass-stats] [--inline-threshold=<n>] [--unroll-factor=<n>] [--jobs=<n>] [<file>]" << std::endl;
+  std::cout << "Passes:";
+  for (const std::string &name : passes.names()) std::cout << " " << name;
+  std::cout << std::endl;
+  return EXIT_FAILURE;
+}
+
 int main(int argc, const char* argv[]) {
   // early stop options
-  bool onlySyntaxOpt  = (argc > 1 and std::strcmp(argv[1], "--onlySyntax") == 0);
-  bool onlySyntaxOpt2 = (argc > 2 and std::strcmp(argv[2], "--onlySyntax") == 0);
-  bool noCodegenOpt   = (argc > 1 and std::strcmp(argv[1], "--noCodegen")  == 0);
-  bool noCodeGenOpt2  = (argc > 2 and std::strcmp(argv[2], "--noCodegen")  == 0);
+  bool onlySyntaxOpt = false;
+  bool noCodegenOpt  = false;
+  // the input file is binary t-code (written with --emit-binary)
+  // instead of an ASL program: it is only optimized and printed
+  bool loadOpt       = false;
+  // output options
+  bool emitBinaryOpt = false;
+  bool memStatsOpt   = false;
+  // check the indexes of arrays at run time
+  bool boundsCheckOpt = false;
+  // optimization options: level, changes to the passes of the level,
+  // report of each pass, growth allowed to a caller by inlining, and
+  // copies of the body of the loops that are partially unrolled
+  unsigned optLevelOpt = 0;
+  std::string passesOpt;
+  bool passStatsOpt  = false;
+  std::size_t inlineThresholdOpt = 8;
+  unsigned unrollFactorOpt = 4;
+  // threads generating code (0: one per hardware thread)
+  unsigned jobsOpt   = 1;
+  // input file (std::cin if empty)
+  std::string inputFileName;
+
+  PassManager passes;
+  addPasses(passes, inlineThresholdOpt, unrollFactorOpt, passStatsOpt);
+
   // check options and correct use of the program
-  if (argc > 3 or onlySyntaxOpt2 or noCodeGenOpt2 or
-      (argc == 3 and not onlySyntaxOpt and not noCodegenOpt)) {
-    std::cout << "Usage: ./asl [--onlySyntax|--noCodegen] [<file>]" << std::endl;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if      (arg == "--onlySyntax")  onlySyntaxOpt = true;
+    else if (arg == "--noCodegen")   noCodegenOpt  = true;
+    else if (arg == "--load")        loadOpt       = true;
+    else if (arg == "--emit-binary") emitBinaryOpt = true;
+    else if (arg == "--mem-stats")   memStatsOpt   = true;
+    else if (arg == "--bounds-check") boundsCheckOpt = true;
+    else if (arg == "-O0" or arg == "-O1" or arg == "-O2") optLevelOpt = arg[2] - '0';
+    else if (arg.compare(0, 9, "--passes=") == 0)
+      passesOpt += (passesOpt.empty() ? "" : ",") + arg.substr(9);
+    else if (arg == "--pass-stats")  passStatsOpt  = true;
+    else if (arg.compare(0, 19, "--inline-threshold=") == 0 and arg.size() > 19 and
+             arg.find_first_not_of("0123456789", 19) == std::string::npos)
+      inlineThresholdOpt = std::stoul(arg.substr(19));
+    else if (arg.compare(0, 16, "--unroll-factor=") == 0 and arg.size() > 16 and
+             arg.find_first_not_of("0123456789", 16) == std::string::npos)
+      unrollFactorOpt = std::stoul(arg.substr(16));
+    else if (arg.compare(0, 7, "--jobs=") == 0 and arg.size() > 7 and
+             arg.find_first_not_of("0123456789", 7) == std::string::npos)
+      jobsOpt = std::stoul(arg.substr(7));
+    else if (arg.compare(0, 1, "-") == 0 or not inputFileName.empty())
+      return usage(passes);
+    else
+      inputFileName = arg;
+  }
+  passes.set_level(optLevelOpt);
+  std::string badPass;
+  if (not passesOpt.empty() and not passes.enable_list(passesOpt, badPass)) {
+    std::cout << "No such pass: " << badPass << std::endl;
+    return usage(passes);
+  }
+  if (onlySyntaxOpt and noCodegenOpt) return usage(passes);
+  // binary t-code is mapped, so it cannot be read from std::cin
+  if (loadOpt and (onlySyntaxOpt or noCodegenOpt or inputFileName.empty()))
+    return usage(passes);
+  if (jobsOpt == 0) jobsOpt = std::max(1u, std::thread::hardware_concurrency());
+  if (not inputFileName.empty() and not std::fopen(inputFileName.c_str(), "r")) {
+    std::cout << "No such file: " << inputFileName << std::endl;
     return EXIT_FAILURE;
   }
-  if (argc == 3 or (argc == 2 and not onlySyntaxOpt and not noCodegenOpt)) {
-    if (not std::fopen(argv[argc-1], "r")) {
-      std::cout << "No such file: " << argv[argc-1] << std::endl;
+
+  // the code generated in this compilation is allocated in this arena,
+  // and released at once when main returns
+  Arena arena;
+  ArenaScope arenaScope(arena);
+
+  // binary t-code is turned back into code with no parsing at all
+  if (loadOpt) {
+    arena.begin_phase("load");
+    MappedCode binary;
+    if (not binary.load(inputFileName)) {
+      std::cout << "Invalid binary t-code: " << binary.error() << std::endl;
       return EXIT_FAILURE;
     }
+    code mycode = binary.to_code();
+    optimizeAndPrint(mycode, passes, arena, passStatsOpt, emitBinaryOpt);
+    if (memStatsOpt) arena.print_stats(std::cerr);
+    return EXIT_SUCCESS;
   }
 
+  arena.begin_phase("parse");
+
   // open input file (or std::cin) and create a character stream
   antlr4::ANTLRInputStream input;
-  if ((argc == 3) or (argc == 2 and not onlySyntaxOpt and not noCodegenOpt)) {  // read from <file>
+  if (not inputFileName.empty()) {  // read from <file>
     std::ifstream stream;
-    stream.open(argv[argc-1]);
+    stream.open(inputFileName);
     input = antlr4::ANTLRInputStream(stream);
   }
   else {            // read fron std::cin
@@ -118,11 +285,13 @@ int main(int argc, const char* argv[]) {
 
   // create a visitor that looks for variables and function declarations
   // in the tree and stores required information
+  arena.begin_phase("symbols");
   SymbolsVisitor symboldecl(types, symbols, decorations, errors);
   symboldecl.visit(tree);
 
   // create another visitor that will perform type checkings wherever
   // it is needed (on expressions, assignments, parameter passing, etc)
+  arena.begin_phase("typecheck");
   TypeCheckVisitor typecheck(types, symbols, decorations, errors);
   typecheck.visit(tree);
 
@@ -138,18 +307,25 @@ int main(int argc, const char* argv[]) {
   
   // create a third visitor that will return the generated code
   // for each part of the tree, and will store it in 'mycode'
-  CodeGenVisitor codegenerator(types, symbols, decorations);
+  // (decorations are only read from now on, maybe by several threads)
+  decorations.freeze();
+  arena.begin_phase("codegen");
+  CodeGenVisitor codegenerator(types, symbols, decorations, jobsOpt, boundsCheckOpt,
+                               passes.enabled("fuse-branches"));
   code mycode = codegenerator.visit(tree);
 
-  // print generated code as output
-  std::cout << mycode.dump() << std::endl;
+  // optimize the code and print it as output
+  optimizeAndPrint(mycode, passes, arena, passStatsOpt, emitBinaryOpt);
+
+  // allocations of each phase (in the heap and in the arena)
+  if (memStatsOpt) arena.print_stats(std::cerr);
   /*
   // uncomment the following lines to generate LLVM code
-  // and write it to a .ll file
+  // and write it to a .ll file (place them before optimizeAndPrint,
+  // as LLVMCodeGen turns block copies into memcpy)
   std::string llvmStr = mycode.dumpLLVM(types, symbols);
   std::string llvmFileName;
-  if (argc == 2) { // read from <file>
-    std::string inputFileName = std::string(argv[1]);
+  if (not inputFileName.empty()) { // read from <file>
     std::size_t slashPos = inputFileName.rfind("/");
     std::size_t dotPos   = inputFileName.rfind(".");
     llvmFileName = inputFileName.substr(slashPos+1, dotPos-slashPos-1) + ".ll";
@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Arena - Region allocation for a whole compilation unit
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "Arena.h"
+
+#include <new>
+#include <iomanip>
+#include <cstdlib>    // malloc, free
+#include <cstring>    // memset
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Counters of the global heap. Only in builds with ARENA_HEAP_STATS
+// defined, the global operator new is replaced to count the calls
+// made by each thread; that is what lets the per-phase statistics
+// compare the heap with the arena. Other builds keep the stock
+// operator new, and the heap counters stay at zero.
+
+namespace {
+  struct heapCounters {
+    size_t allocs;
+    size_t bytes;
+  };
+  thread_local heapCounters heapCount = {0, 0};
+  thread_local Arena *currentArena = nullptr;
+
+#ifdef ARENA_HEAP_STATS
+  const bool COUNTS_HEAP = true;
+
+  void * countedMalloc(size_t size) {
+    ++heapCount.allocs;
+    heapCount.bytes += size;
+    return malloc(size ? size : 1);
+  }
+#else
+  const bool COUNTS_HEAP = false;
+#endif
+}
+
+#ifdef ARENA_HEAP_STATS
+void * operator new(size_t size) {
+  void *p = countedMalloc(size);
+  if (not p) throw std::bad_alloc();
+  return p;
+}
+void * operator new[](size_t size) {
+  void *p = countedMalloc(size);
+  if (not p) throw std::bad_alloc();
+  return p;
+}
+void * operator new(size_t size, const std::nothrow_t &) noexcept { return countedMalloc(size); }
+void * operator new[](size_t size, const std::nothrow_t &) noexcept { return countedMalloc(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+#endif
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'Arena'
+
+Arena::Arena() : next(nullptr), limit(nullptr), reserved(0), inPhase(false) {
+  memset(freeList, 0, sizeof(freeList));
+  total = {"", 0, 0, 0, 0, 0};
+  phaseStart = total;
+}
+
+// all the memory goes back to the system here, at once
+Arena::~Arena() {
+  for (char *b : blocks) free(b);
+}
+
+// arena current in the calling thread
+Arena * Arena::current() { return currentArena; }
+
+void Arena::new_block(size_t minSize) {
+  size_t size = minSize > BLOCK_SIZE ? minSize : BLOCK_SIZE;
+  char *b = static_cast<char *>(malloc(size));
+  if (not b) throw std::bad_alloc();
+  blocks.push_back(b);
+  reserved += size;
+  next = b;
+  limit = b + size;
+}
+
+// get size bytes aligned to align
+void * Arena::allocate(size_t size, size_t align) {
+  if (size == 0) size = 1;
+  ++total.arenaAllocs;
+  total.arenaBytes += size;
+
+  // small blocks are rounded up to a granule, and may be reused
+  if (size <= MAX_SMALL) {
+    size = (size + GRANULE - 1) & ~(GRANULE - 1);
+    void *&head = freeList[size / GRANULE];
+    if (head) {
+      void *p = head;
+      head = *static_cast<void **>(p);
+      ++total.reused;
+      return p;
+    }
+    align = GRANULE;
+  }
+  else if (align < alignof(std::max_align_t)) align = alignof(std::max_align_t);
+
+  size_t pad = (align - reinterpret_cast<size_t>(next) % align) % align;
+  if (next == nullptr or pad + size > size_t(limit - next)) {
+    new_block(size + align);
+    pad = (align - reinterpret_cast<size_t>(next) % align) % align;
+  }
+  void *p = next + pad;
+  next += pad + size;
+  return p;
+}
+
+// give back a block got from allocate
+void Arena::deallocate(void *p, size_t size) {
+  if (p == nullptr or size > MAX_SMALL) return;  // freed with the arena
+  if (size == 0) size = 1;
+  size = (size + GRANULE - 1) & ~(GRANULE - 1);
+  *static_cast<void **>(p) = freeList[size / GRANULE];
+  freeList[size / GRANULE] = p;
+}
+
+// close the current phase (if any) and start a new one
+void Arena::begin_phase(const std::string &name) {
+  end_phase();
+  total.heapAllocs = heapCount.allocs;
+  total.heapBytes = heapCount.bytes;
+  phaseStart = total;
+  phaseStart.name = name;
+  inPhase = true;
+}
+
+// close the current phase (if any)
+void Arena::end_phase() {
+  if (not inPhase) return;
+  total.heapAllocs = heapCount.allocs;
+  total.heapBytes = heapCount.bytes;
+  phaseStats ph;
+  ph.name = phaseStart.name;
+  ph.arenaAllocs = total.arenaAllocs - phaseStart.arenaAllocs;
+  ph.arenaBytes = total.arenaBytes - phaseStart.arenaBytes;
+  ph.reused = total.reused - phaseStart.reused;
+  ph.heapAllocs = total.heapAllocs - phaseStart.heapAllocs;
+  ph.heapBytes = total.heapBytes - phaseStart.heapBytes;
+  inPhase = false;
+  phases.push_back(ph);
+}
+
+// counters of all the closed phases
+const std::vector<Arena::phaseStats> & Arena::get_phases() const { return phases; }
+// bytes reserved from the system for the arena blocks
+size_t Arena::get_reserved() const { return reserved; }
+
+// print a table with the counters of every phase
+void Arena::print_stats(std::ostream &out) const {
+  out << std::left << std::setw(12) << "phase" << std::right
+      << std::setw(12) << "heap allocs" << std::setw(14) << "heap bytes"
+      << std::setw(13) << "arena allocs" << std::setw(14) << "arena bytes"
+      << std::setw(10) << "reused" << std::endl;
+  for (auto &ph : phases)
+    out << std::left << std::setw(12) << ph.name << std::right
+        << std::setw(12) << ph.heapAllocs << std::setw(14) << ph.heapBytes
+        << std::setw(13) << ph.arenaAllocs << std::setw(14) << ph.arenaBytes
+        << std::setw(10) << ph.reused << std::endl;
+  out << "arena blocks: " << blocks.size() << " (" << reserved << " bytes)" << std::endl;
+  if (not COUNTS_HEAP)
+    out << "heap not counted (build with -DARENA_HEAP_STATS)" << std::endl;
+}
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'ArenaScope'
+
+ArenaScope::ArenaScope(Arena &a) : previous(currentArena) { currentArena = &a; }
+ArenaScope::~ArenaScope() { currentArena = previous; }
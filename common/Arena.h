@@ -0,0 +1,172 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Arena - Region allocation for a whole compilation unit
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <type_traits>
+#include <cstddef>    // std::size_t
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class Arena: a bump allocator that owns the products of one
+// compilation (instructions, vars, label indexes, rope chunks...).
+// Memory is taken from big blocks and given back to the system all
+// at once, when the arena is destroyed. Small blocks that are freed
+// before that are kept in per-size free lists and reused.
+//
+// Allocators (see arenaAllocator below) take the arena that is
+// current in their thread when they are created. Use an ArenaScope
+// to make an arena current.
+//
+// The arena also keeps per-phase counters (see begin_phase) of its
+// own allocations. Those made with the global heap are counted only
+// when ARENA_HEAP_STATS is defined, as that replaces the global
+// operator new of the whole program (see Arena.cpp).
+
+class Arena {
+
+public:
+
+  Arena();
+  ~Arena();
+  Arena(const Arena &) = delete;
+  Arena & operator=(const Arena &) = delete;
+
+  // get size bytes aligned to align (a power of 2, at most 16)
+  void * allocate(std::size_t size, std::size_t align);
+  // give back a block got from allocate (kept for reuse if it is small)
+  void deallocate(void *p, std::size_t size);
+
+  // arena current in the calling thread (nullptr if none)
+  static Arena * current();
+
+  // counters of a phase of the compilation (those of the heap stay
+  // at 0 without ARENA_HEAP_STATS)
+  struct phaseStats {
+    std::string name;
+    std::size_t arenaAllocs;   // blocks given by the arena
+    std::size_t arenaBytes;    // bytes given by the arena
+    std::size_t reused;        // blocks taken from the free lists
+    std::size_t heapAllocs;    // calls to the global operator new
+    std::size_t heapBytes;     // bytes asked to the global operator new
+  };
+
+  // close the current phase (if any) and start a new one
+  void begin_phase(const std::string &name);
+  // close the current phase (if any)
+  void end_phase();
+  // counters of all the closed phases
+  const std::vector<phaseStats> & get_phases() const;
+  // bytes reserved from the system for the arena blocks
+  std::size_t get_reserved() const;
+  // print a table with the counters of every phase
+  void print_stats(std::ostream &out) const;
+
+private:
+
+  static const std::size_t BLOCK_SIZE = 256 * 1024;
+  static const std::size_t GRANULE = 16;
+  static const std::size_t MAX_SMALL = 256;   // bigger blocks are not reused
+
+  std::vector<char *> blocks;
+  char *next;
+  char *limit;
+  std::size_t reserved;
+  // free lists, one per multiple of GRANULE up to MAX_SMALL
+  void *freeList[MAX_SMALL / GRANULE + 1];
+
+  // running counters, and their values when the phase began
+  phaseStats total;
+  phaseStats phaseStart;
+  bool inPhase;
+  std::vector<phaseStats> phases;
+
+  void new_block(std::size_t minSize);
+};
+
+
+////////////////////////////////////////////////////////////////
+// Class ArenaScope makes an arena current in the calling thread
+// while the scope object is alive (scopes can be nested).
+
+class ArenaScope {
+public:
+  explicit ArenaScope(Arena &a);
+  ~ArenaScope();
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope & operator=(const ArenaScope &) = delete;
+private:
+  Arena *previous;
+};
+
+
+////////////////////////////////////////////////////////////////
+// Template arenaAllocator<T>: standard allocator that takes memory
+// from the arena that was current when it was created. Without a
+// current arena it behaves as std::allocator, so containers can also
+// be used out of a compilation. A copy of a container takes the arena
+// current where the copy is made (so code generated by another thread,
+// in its own arena, can be copied into the arena of the compilation).
+
+template <class T>
+class arenaAllocator {
+public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  arenaAllocator() : arena(Arena::current()) {}
+  template <class U>
+  arenaAllocator(const arenaAllocator<U> &o) : arena(o.arena) {}
+
+  T * allocate(std::size_t n) {
+    if (arena) return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T *p, std::size_t n) {
+    if (arena) arena->deallocate(p, n * sizeof(T));
+    else ::operator delete(p);
+  }
+
+  arenaAllocator select_on_container_copy_construction() const { return arenaAllocator(); }
+
+  template <class U>
+  bool operator==(const arenaAllocator<U> &o) const { return arena == o.arena; }
+  template <class U>
+  bool operator!=(const arenaAllocator<U> &o) const { return arena != o.arena; }
+
+  template <class U> friend class arenaAllocator;
+
+private:
+  Arena *arena;
+};
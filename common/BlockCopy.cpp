@@ -0,0 +1,89 @@
+/////////////////////////////////////////////////////////////////
+//
+//    BlockCopy - Expansion of block copies for the t-code VM
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "BlockCopy.h"
+
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'BlockCopy'
+
+// expand the block copies of all the subroutines of c (labels are
+// numbered across the whole code)
+size_t BlockCopy::expand(code &c) {
+  size_t count = 0;
+  for (size_t f = 0; f < c.get_subroutine_list().size(); ++f) {
+    subroutine &s = c.get_subroutine_at(f);
+    constSpan<instruction> code = s.get_instructions();
+    bool found = false;
+    for (const instruction &i : code) found = found or i.oper == instruction::_BCOPY;
+    if (not found) continue;
+
+    uint32_t nextTemp = s.max_temp();
+    auto temp = [&nextTemp]() { return operand::make(operand::_TEMP, ++nextTemp); };
+    instructionList out;
+    for (const instruction &i : code) {
+      if (i.oper != instruction::_BCOPY) {
+        out = out || i;
+        continue;
+      }
+      size_t n = stoul(i.arg3.to_string());
+      if (n <= UNROLL_LIMIT) {
+        for (size_t k = 0; k < n; ++k) {
+          operand idx = temp(), val = temp();
+          out = out || instruction(instruction::_ILOAD, idx, operand(operand::_INT, to_string(k)))
+                    || instruction(instruction::_LOADX, val, i.arg2, idx)
+                    || instruction(instruction::_XLOAD, i.arg1, idx, val);
+        }
+      }
+      else {
+        operand idx = temp(), step = temp(), size = temp(), cond = temp(), val = temp();
+        string label = "_bcopy" + to_string(count);
+        operand loop(operand::_LABEL, label), end(operand::_LABEL, label + "end");
+        out = out || instruction(instruction::_ILOAD, idx, operand(operand::_INT, "0"))
+                  || instruction(instruction::_ILOAD, step, operand(operand::_INT, "1"))
+                  || instruction(instruction::_ILOAD, size, i.arg3)
+                  || instruction(instruction::_LABEL, loop)
+                  || instruction(instruction::_LT, cond, idx, size)
+                  || instruction(instruction::_FJUMP, cond, end)
+                  || instruction(instruction::_LOADX, val, i.arg2, idx)
+                  || instruction(instruction::_XLOAD, i.arg1, idx, val)
+                  || instruction(instruction::_ADD, idx, idx, step)
+                  || instruction(instruction::_UJUMP, loop)
+                  || instruction(instruction::_LABEL, end);
+      }
+      ++count;
+    }
+    s.set_instructions(out);
+  }
+  return count;
+}
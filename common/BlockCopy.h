@@ -0,0 +1,71 @@
+/////////////////////////////////////////////////////////////////
+//
+//    BlockCopy - Expansion of block copies for the t-code VM
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class BlockCopy rewrites each "bcopy a b n" (an assignment of whole
+// arrays) as the element by element copy that the VM can run:
+//
+//    %i = 0
+//    %s = 1
+//    %n = n
+//    label _bcopyK :
+//    %c = %i < %n
+//    ifFalse %c goto _bcopyKend
+//    %t = b[%i]
+//    a[%i] = %t
+//    %i = %i + %s
+//    goto _bcopyK
+//    label _bcopyKend :
+//
+// Copies of up to UNROLL_LIMIT elements are written without the
+// loop, as a load and a store per element.
+//
+// The passes and LLVMCodeGen (which emits a memcpy) see the single
+// instruction; the expansion is only for the t-code given to the VM,
+// so it runs right before the code is written.
+
+class BlockCopy {
+
+public:
+
+  // expand the block copies of all the subroutines of c; returns how
+  // many were expanded
+  static std::size_t expand(code &c);
+
+  // longest copy written without a loop
+  static const std::size_t UNROLL_LIMIT = 4;
+};
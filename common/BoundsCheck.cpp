@@ -0,0 +1,384 @@
+/////////////////////////////////////////////////////////////////
+//
+//    BoundsCheck - Removal of index checks proved by range analysis
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "BoundsCheck.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'BoundsCheck'
+
+namespace {
+
+  const int64_t MIN = INT32_MIN;
+  const int64_t MAX = INT32_MAX;
+
+  // values an integer variable may have (empty if lo > hi)
+  struct range {
+    int64_t lo, hi;
+    bool empty() const { return lo > hi; }
+    bool operator==(const range &o) const { return lo == o.lo and hi == o.hi; }
+    bool operator!=(const range &o) const { return not (*this == o); }
+  };
+
+  range all() { return range{MIN, MAX}; }
+  range single(int64_t v) { return range{v, v}; }
+  range boolean() { return range{0, 1}; }
+  // the result of an operation, which may wrap if out of 32 bits
+  range wrapped(int64_t lo, int64_t hi) { return lo < MIN or hi > MAX ? all() : range{lo, hi}; }
+
+  // ranges of all the variables at some point (or unreached)
+  struct state {
+    bool reached;
+    vector<range> vars;
+    bool operator!=(const state &o) const { return reached != o.reached or vars != o.vars; }
+  };
+
+  class analysis {
+  public:
+    analysis(const FlowGraph &g, const DataFlow &df) : g(g), df(df) {}
+
+    range & of(vector<range> &v, const operand &o) { return v[df.var_index(o)]; }
+
+    // ranges after instruction i
+    void transfer(const instruction &i, vector<range> &v) {
+      operand d = i.def();
+      if (d.empty()) return;
+      range r = all();
+      range a = i.arg2.is_address() ? of(v, i.arg2) : all();
+      range b = i.arg3.is_address() ? of(v, i.arg3) : all();
+      switch (i.oper) {
+      case instruction::_ILOAD:
+        if (i.arg2.kind() == operand::_INT) r = single(stoll(i.arg2.to_string()));
+        else if (i.arg2.is_address()) r = a;
+        break;
+      case instruction::_LOAD:
+        if (i.arg2.is_address()) r = a;
+        break;
+      case instruction::_ADD: r = wrapped(a.lo + b.lo, a.hi + b.hi); break;
+      case instruction::_SUB: r = wrapped(a.lo - b.hi, a.hi - b.lo); break;
+      case instruction::_NEG: r = wrapped(-a.hi, -a.lo); break;
+      case instruction::_MUL: {
+        int64_t p[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+        r = wrapped(*min_element(p, p + 4), *max_element(p, p + 4));
+        break;
+      }
+      case instruction::_DIV:
+        // truncation is monotonic when dividing by a positive constant
+        if (b.lo == b.hi and b.lo > 0) r = range{a.lo / b.lo, a.hi / b.lo};
+        break;
+      case instruction::_EQ:
+        if (a.lo == a.hi and b.lo == b.hi and a.lo == b.lo) r = single(1);
+        else if (a.hi < b.lo or b.hi < a.lo)               r = single(0);
+        else                                               r = boolean();
+        break;
+      case instruction::_LT:
+        r = a.hi < b.lo ? single(1) : a.lo >= b.hi ? single(0) : boolean();
+        break;
+      case instruction::_LE:
+        r = a.hi <= b.lo ? single(1) : a.lo > b.hi ? single(0) : boolean();
+        break;
+      case instruction::_AND: case instruction::_OR: case instruction::_NOT:
+        if (a.lo < 0 or a.hi > 1) a = boolean();
+        if (b.lo < 0 or b.hi > 1) b = boolean();
+        if (i.oper == instruction::_AND)     r = range{min(a.lo, b.lo), min(a.hi, b.hi)};
+        else if (i.oper == instruction::_OR) r = range{max(a.lo, b.lo), max(a.hi, b.hi)};
+        else                                 r = range{1 - a.hi, 1 - a.lo};
+        break;
+      default:
+        break;
+      }
+      of(v, d) = r;
+    }
+
+    // ranges at the end of block b (before its jump, if any)
+    void transfer(size_t b, vector<range> &v) {
+      for (const instruction &i : g.block(b).instrs) transfer(i, v);
+    }
+
+    // narrow v, the ranges at the end of b, knowing that c, defined
+    // before position 'end' of the block, is 'value'. False if that
+    // is impossible
+    bool assume(size_t b, size_t end, const operand &c, bool value, vector<range> &v) {
+      // a literal (possible in loaded code) tells nothing
+      if (not c.is_address()) return true;
+      range &rc = of(v, c);
+      if (rc.lo > value or rc.hi < value) return false;
+      const arenaVector<instruction> &code = g.block(b).instrs;
+      size_t k = end;
+      while (k > 0 and code[k-1].def() != c) --k;
+      if (k == 0) return true;
+      const instruction &i = code[--k];
+
+      // the operands must keep until the end of the block the values
+      // they had when c was computed
+      operand u[3];
+      int n = i.uses(u);
+      for (size_t j = k + 1; j < code.size(); ++j)
+        for (int x = 0; x < n; ++x)
+          if (code[j].def() == u[x]) return true;
+
+      switch (i.oper) {
+      case instruction::_LT: case instruction::_LE: case instruction::_EQ:
+        return relate(i.oper, i.arg2, i.arg3, value, v);
+      case instruction::_AND:
+        return not value or (assume(b, k, i.arg2, true, v) and assume(b, k, i.arg3, true, v));
+      case instruction::_OR:
+        return value or (assume(b, k, i.arg2, false, v) and assume(b, k, i.arg3, false, v));
+      case instruction::_NOT:
+        return assume(b, k, i.arg2, not value, v);
+      default:
+        return true;
+      }
+    }
+
+    // narrow v knowing that the comparison rel (_LT, _LE or _EQ) of x
+    // and y is 'value'. False if that is impossible
+    bool relate(instruction::Operation rel, const operand &x, const operand &y,
+                bool value, vector<range> &v) {
+      // a literal (possible in loaded code) has no range to narrow
+      if (not x.is_address() or not y.is_address()) return true;
+      switch (rel) {
+      case instruction::_LT: case instruction::_LE: {
+        if (x == y) return true;
+        range &a = of(v, x), &b = of(v, y);
+        // "a < b" or "a <= b" when true; "b <= a" or "b < a" when false
+        if (value) less(a, b, rel == instruction::_LT);
+        else       less(b, a, rel == instruction::_LE);
+        return not a.empty() and not b.empty();
+      }
+      case instruction::_EQ: {
+        if (not value) return true;
+        range &a = of(v, x), &b = of(v, y);
+        a.lo = b.lo = max(a.lo, b.lo);
+        a.hi = b.hi = min(a.hi, b.hi);
+        return not a.empty();
+      }
+      default:
+        return true;
+      }
+    }
+
+    // a < b (strict) or a <= b
+    static void less(range &a, range &b, bool strict) {
+      a.hi = min(a.hi, b.hi - strict);
+      b.lo = max(b.lo, a.lo + strict);
+    }
+
+    // ranges along the edge from b (with ranges 'out' at its end) to s
+    state along(size_t b, const vector<range> &out, size_t s) {
+      state e{true, out};
+      const instruction *last = g.block(b).last();
+      if (last and last->is_cond_jump()) {
+        bool jumps = g.jump_target(b) == s, falls = g.block(b).fallthrough == s;
+        if (jumps != falls and last->oper == instruction::_FJUMP)
+          e.reached = assume(b, g.block(b).instrs.size() - 1, last->arg1, falls, e.vars);
+        else if (jumps != falls) {
+          // a compare-and-branch falls through when its comparison holds
+          bool negated;
+          instruction::Operation rel = instruction::branch_relation(last->oper, negated);
+          e.reached = relate(rel, last->arg1, last->arg2, falls != negated, e.vars);
+        }
+      }
+      return e;
+    }
+
+    // ranges at the entry of every block
+    vector<state> solve() {
+      size_t nb = g.num_blocks(), nv = df.num_vars();
+      vector<bool> header(nb, false);
+      for (size_t b : g.reverse_postorder())
+        for (size_t p : g.block(b).preds)
+          if (g.dominates(b, p)) header[b] = true;
+
+      vector<state> in(nb, state{false, vector<range>(nv, all())});
+      in[0].reached = true;
+      // increasing iterations, widening at the loop headers
+      bool changed = true;
+      while (changed) {
+        changed = false;
+        for (size_t b : g.reverse_postorder()) {
+          if (not in[b].reached) continue;
+          vector<range> out = in[b].vars;
+          transfer(b, out);
+          for (size_t s : g.block(b).succs) {
+            state e = along(b, out, s);
+            if (not e.reached) continue;
+            state &t = in[s];
+            state old = t;
+            if (not t.reached) t = e;
+            else
+              for (size_t x = 0; x < nv; ++x) {
+                range &r = t.vars[x];
+                const range &n = e.vars[x];
+                if (header[s]) {
+                  if (n.lo < r.lo) r.lo = MIN;
+                  if (n.hi > r.hi) r.hi = MAX;
+                }
+                else {
+                  r.lo = min(r.lo, n.lo);
+                  r.hi = max(r.hi, n.hi);
+                }
+              }
+            if (t != old) changed = true;
+          }
+        }
+      }
+      // decreasing iterations, to narrow what was widened
+      for (int round = 0; round < 2; ++round) {
+        vector<state> next(nb, state{false, vector<range>(nv, all())});
+        next[0].reached = true;
+        for (size_t b : g.reverse_postorder()) {
+          if (not in[b].reached) continue;
+          vector<range> out = in[b].vars;
+          transfer(b, out);
+          for (size_t s : g.block(b).succs) {
+            state e = along(b, out, s);
+            if (not e.reached) continue;
+            state &t = next[s];
+            if (s == 0) continue;
+            if (not t.reached) t = e;
+            else
+              for (size_t x = 0; x < nv; ++x) {
+                t.vars[x].lo = min(t.vars[x].lo, e.vars[x].lo);
+                t.vars[x].hi = max(t.vars[x].hi, e.vars[x].hi);
+              }
+          }
+        }
+        in.swap(next);
+      }
+      return in;
+    }
+
+  private:
+    const FlowGraph &g;
+    const DataFlow &df;
+  };
+
+  // instructions that compute the check ending block b and nothing
+  // else: the jump, and the constants, comparisons and 'and' whose
+  // values are only used by other instructions of the check
+  vector<size_t> check_code(const FlowGraph &g, DataFlow &df, size_t b) {
+    typedef DataFlow::site site;
+    const arenaVector<instruction> &code = g.block(b).instrs;
+    vector<bool> dead(code.size(), false);
+    vector<size_t> pending(1, code.size() - 1);
+    dead.back() = true;
+    while (not pending.empty()) {
+      site s{uint32_t(b), uint32_t(pending.back())};
+      pending.pop_back();
+      operand u[3];
+      int n = code[s.index].uses(u);
+      for (int j = 0; j < n; ++j) {
+        const vector<site> &defs = df.defs_of_use(s, j);
+        if (defs.size() != 1 or defs[0] == DataFlow::ENTRY or defs[0].block != b or
+            dead[defs[0].index])
+          continue;
+        const instruction &d = code[defs[0].index];
+        if (not d.def().is_temp() or
+            (d.oper != instruction::_ILOAD and d.oper != instruction::_LE and
+             d.oper != instruction::_LT and d.oper != instruction::_AND))
+          continue;
+        bool only = true;
+        for (const site &x : df.uses_of_def(defs[0]))
+          only = only and x.block == b and dead[x.index];
+        if (not only) continue;
+        dead[defs[0].index] = true;
+        pending.push_back(defs[0].index);
+      }
+    }
+    vector<size_t> found;
+    for (size_t k = 0; k < code.size(); ++k)
+      if (dead[k]) found.push_back(k);
+    return found;
+  }
+
+  // true if block b only halts with an index out of range
+  bool halts_out_of_range(const FlowGraph &g, size_t b) {
+    for (const instruction &i : g.block(b).instrs) {
+      if (i.oper == instruction::_LABEL) continue;
+      return i.oper == instruction::_HALT and i.arg1.to_string() == code::INDEX_OUT_OF_RANGE;
+    }
+    return false;
+  }
+
+}
+
+// remove the checks of s that never fail; returns how many
+size_t BoundsCheck::run(subroutine &s) {
+  FlowGraph g(s);
+  vector<size_t> checks;
+  for (size_t b : g.reverse_postorder()) {
+    const instruction *last = g.block(b).last();
+    if (last and last->oper == instruction::_FJUMP and halts_out_of_range(g, g.jump_target(b)))
+      checks.push_back(b);
+  }
+  if (checks.empty()) return 0;
+
+  DataFlow df(g);
+  analysis ranges(g, df);
+  vector<state> in = ranges.solve();
+  // the checks that never fail, and the code computing them
+  vector<size_t> proven;
+  for (size_t b : checks) {
+    if (not in[b].reached) continue;
+    vector<range> out = in[b].vars;
+    ranges.transfer(b, out);
+    const operand &c = g.block(b).last()->arg1;
+    if (c.is_address() and ranges.of(out, c) == single(1)) proven.push_back(b);
+  }
+  if (proven.empty()) return 0;
+  vector<vector<size_t>> dead;
+  for (size_t b : proven) dead.push_back(check_code(g, df, b));
+  for (size_t k = 0; k < proven.size(); ++k) {
+    basicBlock &bb = g.block(proven[k]);
+    arenaVector<instruction> code;
+    size_t next = 0;
+    for (size_t j = 0; j < bb.instrs.size(); ++j) {
+      if (next < dead[k].size() and dead[k][next] == j) ++next;
+      else code.push_back(bb.instrs[j]);
+    }
+    bb.instrs.swap(code);
+  }
+
+  // halting blocks no check jumps to any more
+  g.recompute_edges();
+  for (size_t b = 1; b < g.num_blocks(); ++b)
+    if (not g.block(b).removed and g.block(b).preds.empty() and halts_out_of_range(g, b))
+      g.block(b).removed = true;
+  g.apply(s);
+  return proven.size();
+}
@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////////////////
+//
+//    BoundsCheck - Removal of index checks proved by range analysis
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class BoundsCheck removes the index checks that can never fail.
+// A check is a conditional jump to a block that halts with
+// code::INDEX_OUT_OF_RANGE (CodeGenVisitor emits one before every
+// access a[i] when it is asked to, jumping when not 0 <= i < size).
+//
+// Whether a check can fail is decided by a range analysis: every
+// integer variable gets, at the entry of every block, an interval
+// holding all the values it may have there. Conditional jumps narrow
+// the intervals of the variables compared along each edge (in
+// "while i < 10" the body sees i <= 9), comparisons give 0 or 1 when
+// the intervals decide them, and loops are solved widening the
+// intervals that keep growing at their headers, then narrowing them
+// again. Results that may overflow (and wrap) are unknown.
+//
+// With a check that never fails go the constants, comparisons and
+// 'and' that only compute its condition, and the halting blocks no
+// check jumps to any more. Anything else is left to DeadCode.
+
+class BoundsCheck {
+
+public:
+
+  // remove the checks of s that never fail; returns how many
+  static std::size_t run(subroutine &s);
+};
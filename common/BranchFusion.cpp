@@ -0,0 +1,109 @@
+/////////////////////////////////////////////////////////////////
+//
+//    BranchFusion - Fusion of comparisons with the jumps they decide
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "BranchFusion.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'BranchFusion'
+
+namespace {
+
+  // true if the instruction at k of block b writes a temporal that
+  // is only read by the instruction at 'reader' of the same block
+  bool only_feeds(DataFlow &df, const arenaVector<instruction> &code,
+                  size_t b, size_t k, size_t reader) {
+    if (not code[k].def().is_temp()) return false;
+    const vector<DataFlow::site> &uses = df.uses_of_def(DataFlow::site{uint32_t(b), uint32_t(k)});
+    return uses.size() == 1 and uses[0] == DataFlow::site{uint32_t(b), uint32_t(reader)};
+  }
+
+  bool is_comparison(instruction::Operation op) {
+    return op == instruction::_EQ  or op == instruction::_LT  or op == instruction::_LE or
+           op == instruction::_FEQ or op == instruction::_FLT or op == instruction::_FLE;
+  }
+
+}
+
+// fuse the comparisons of s with their jumps; returns how many jumps
+// were fused
+size_t BranchFusion::run(subroutine &s) {
+  FlowGraph g(s);
+  DataFlow df(g);
+  size_t fused = 0;
+  for (size_t b = 0; b < g.num_blocks(); ++b) {
+    basicBlock &bb = g.block(b);
+    if (bb.removed) continue;
+    arenaVector<instruction> &code = bb.instrs;
+    size_t n = code.size();
+    if (n < 2 or code[n-1].oper != instruction::_FJUMP) continue;
+
+    // the condition, computed right before the jump, maybe negated
+    size_t jump = n - 1, first = n - 2;
+    if (code[first].def() != code[jump].arg1 or not only_feeds(df, code, b, first, jump))
+      continue;
+    bool negated = false;
+    if (code[first].oper == instruction::_NOT) {
+      if (first == 0 or code[first-1].def() != code[first].arg2 or
+          not only_feeds(df, code, b, first - 1, first))
+        continue;
+      --first;
+      negated = true;
+    }
+    const instruction &cmp = code[first];
+    if (not is_comparison(cmp.oper) or
+        not cmp.arg2.is_address() or not cmp.arg3.is_address())
+      continue;
+
+    instruction::Operation rel = cmp.oper;
+    operand x = cmp.arg2, y = cmp.arg3;
+    // not (a < b) is b <= a, and not (a <= b) is b < a, for integers
+    if (negated and (rel == instruction::_LT or rel == instruction::_LE)) {
+      rel = (rel == instruction::_LT ? instruction::_LE : instruction::_LT);
+      swap(x, y);
+      negated = false;
+    }
+    instruction::Operation op = instruction::branch_on(rel, negated);
+    if (op == instruction::_INVALID) continue;
+
+    instruction branch(op, x, y, code[jump].jump_label());
+    code.erase(code.begin() + first, code.end());
+    code.push_back(branch);
+    df.update_block(b);
+    ++fused;
+  }
+  if (fused > 0) g.apply(s);
+  return fused;
+}
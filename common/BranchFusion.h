@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////////////////
+//
+//    BranchFusion - Fusion of comparisons with the jumps they decide
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class BranchFusion replaces a comparison whose result is only read
+// by the conditional jump that ends its block with a single
+// compare-and-branch instruction:
+//
+//    %c = a < b
+//    ifFalse %c goto L    becomes    ifFalse a < b goto L
+//
+// The negations the code generator writes for != (a "not" of an
+// == or ==.) and for jumps on true are fused as well: an integer
+// "not (a < b)" is "b <= a", and the != forms test the negation of
+// == and ==. directly. A float < or <= under a "not" is left as it
+// is: comparisons with NaN are false, so it has no fused form.
+//
+// The pass is in no optimization level, because the VM in tvm/ does
+// not know these instructions. In asl, --passes=+fuse-branches turns
+// it on, together with the same lowering in the code generator.
+
+class BranchFusion {
+
+public:
+
+  // fuse the comparisons of s with their jumps; returns how many
+  // jumps were fused
+  static std::size_t run(subroutine &s);
+};
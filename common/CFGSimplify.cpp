@@ -0,0 +1,330 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CFGSimplify - Jump threading and simplification of the flow graph
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "CFGSimplify.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <set>
+#include <cstdint>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'CFGSimplify'
+
+namespace {
+
+  typedef DataFlow::site site;
+
+  const size_t NONE = FlowGraph::NONE;
+
+  // rounds of simplification at most (each one may enable more)
+  const unsigned MAX_ROUNDS = 16;
+
+  // instructions of a block besides its label
+  size_t body_size(const basicBlock &bb) {
+    size_t n = 0;
+    for (const instruction &i : bb.instrs)
+      if (i.oper != instruction::_LABEL) ++n;
+    return n;
+  }
+
+  // block laid out right after each block (NONE for the last one)
+  vector<size_t> next_blocks(const FlowGraph &g) {
+    vector<size_t> next(g.num_blocks(), NONE);
+    size_t prev = NONE;
+    for (size_t b : g.layout()) {
+      if (g.block(b).removed) continue;
+      if (prev != NONE) next[prev] = b;
+      prev = b;
+    }
+    return next;
+  }
+
+  // block where the control goes when it reaches b, through empty
+  // blocks and (if 'gotos' is set) blocks that only hold a goto
+  size_t final_target(const FlowGraph &g, size_t b, bool gotos) {
+    for (size_t steps = 0; steps < g.num_blocks(); ++steps) {
+      const basicBlock &bb = g.block(b);
+      size_t n = body_size(bb), t;
+      if (n == 0)
+        t = bb.fallthrough;
+      else if (gotos and n == 1 and bb.last()->oper == instruction::_UJUMP)
+        t = g.jump_target(b);
+      else
+        break;
+      if (t == NONE or t == b or g.block(t).removed) break;
+      b = t;
+    }
+    return b;
+  }
+
+  size_t remove_unreachable(FlowGraph &g) {
+    size_t count = 0;
+    for (size_t b = 0; b < g.num_blocks(); ++b)
+      if (not g.block(b).removed and not g.reachable(b)) {
+        g.block(b).removed = true;
+        ++count;
+      }
+    return count;
+  }
+
+  // jumps (and fallthroughs, only through empty blocks) go straight
+  // to their final target
+  size_t thread_jumps(FlowGraph &g) {
+    size_t count = 0;
+    for (size_t b = 0; b < g.num_blocks(); ++b) {
+      basicBlock &bb = g.block(b);
+      if (bb.removed) continue;
+      size_t t = g.jump_target(b);
+      if (t != NONE) {
+        size_t f = final_target(g, t, true);
+        if (f != t) {
+          operand lab = g.ensure_label(f);
+          bb.last()->jump_label() = lab;
+          ++count;
+        }
+      }
+      if (bb.falls_through() and bb.fallthrough != NONE and not g.block(bb.fallthrough).removed) {
+        size_t f = final_target(g, bb.fallthrough, false);
+        if (f != bb.fallthrough) {
+          bb.fallthrough = f;
+          ++count;
+        }
+      }
+    }
+    return count;
+  }
+
+  // a goto to the next block, or a conditional jump to the block that
+  // follows when it does not jump, is useless
+  size_t drop_jumps(FlowGraph &g) {
+    vector<size_t> next = next_blocks(g);
+    size_t count = 0;
+    for (size_t b = 0; b < g.num_blocks(); ++b) {
+      basicBlock &bb = g.block(b);
+      if (bb.removed) continue;
+      size_t t = g.jump_target(b);
+      if (t == NONE) continue;
+      if (bb.last()->oper == instruction::_UJUMP) {
+        if (t != next[b]) continue;
+        bb.fallthrough = t;
+      }
+      else if (t != bb.fallthrough)
+        continue;
+      bb.instrs.pop_back();
+      ++count;
+    }
+    return count;
+  }
+
+  // a block with a single successor that has no other predecessor
+  // absorbs it
+  size_t merge_blocks(FlowGraph &g) {
+    vector<bool> touched(g.num_blocks(), false);
+    size_t count = 0;
+    for (size_t a : g.layout()) {
+      basicBlock &ba = g.block(a);
+      if (ba.removed or touched[a] or ba.succs.size() != 1) continue;
+      size_t b = ba.succs[0];
+      if (b == a or b == 0 or b >= g.num_blocks() or touched[b] or
+          g.block(b).preds.size() != 1)
+        continue;
+      const instruction *last = ba.last();
+      if (last and last->is_cond_jump()) continue;
+      if (last and last->oper == instruction::_UJUMP) ba.instrs.pop_back();
+      basicBlock &bb = g.block(b);
+      for (const instruction &i : bb.instrs)
+        if (i.oper != instruction::_LABEL) ba.instrs.push_back(i);
+      ba.fallthrough = bb.fallthrough;
+      bb.removed = true;
+      touched[a] = touched[b] = true;
+      ++count;
+    }
+    return count;
+  }
+
+  // true if the conditional jump that ends b can be inverted (see
+  // CFGSimplify.h). For an ifFalse, 'def' is the position in b of
+  // the comparison or "not" that computes its condition
+  bool invertible(const FlowGraph &g, DataFlow &df, size_t b, size_t &def) {
+    const basicBlock &bb = g.block(b);
+    size_t n = bb.instrs.size();
+    const instruction &j = bb.instrs[n-1];
+    def = NONE;
+    if (j.oper != instruction::_FJUMP) {
+      bool negated;
+      instruction::Operation rel = instruction::branch_relation(j.oper, negated);
+      return rel == instruction::_LT or rel == instruction::_LE or
+             rel == instruction::_EQ or rel == instruction::_FEQ;
+    }
+    size_t k = n - 1;
+    while (k > 0 and bb.instrs[k-1].def() != j.arg1) --k;
+    if (k-- == 0) return false;
+    const instruction &c = bb.instrs[k];
+    if (c.oper != instruction::_LT and c.oper != instruction::_LE and c.oper != instruction::_NOT)
+      return false;
+    const vector<site> &uses = df.uses_of_def(site{uint32_t(b), uint32_t(k)});
+    if (uses.size() != 1 or uses[0] != site{uint32_t(b), uint32_t(n - 1)}) return false;
+    if (c.oper == instruction::_NOT)
+      for (size_t m = k + 1; m + 1 < n; ++m)
+        if (bb.instrs[m].def() == c.arg2) return false;
+    def = k;
+    return true;
+  }
+
+  // the instructions of 'code' from 'from' on, ending in the inverse
+  // of its conditional jump (see invertible), that goes to 'target'
+  void invert(const arenaVector<instruction> &code, size_t from, size_t def,
+              const operand &target, arenaVector<instruction> &out) {
+    size_t n = code.size();
+    for (size_t k = from; k + 1 < n; ++k) {
+      const instruction &i = code[k];
+      if (k != def)
+        out.push_back(i);
+      else if (i.oper != instruction::_NOT)
+        // not (a < b) is b <= a, and not (a <= b) is b < a
+        out.push_back(instruction(i.oper == instruction::_LT ? instruction::_LE : instruction::_LT,
+                                  i.arg1, i.arg3, i.arg2));
+    }
+    const instruction &j = code[n-1];
+    if (j.oper == instruction::_FJUMP) {
+      operand cond = code[def].oper == instruction::_NOT ? code[def].arg2 : j.arg1;
+      out.push_back(instruction(instruction::_FJUMP, cond, target));
+      return;
+    }
+    bool negated;
+    instruction::Operation rel = instruction::branch_relation(j.oper, negated);
+    if (rel == instruction::_LT)
+      out.push_back(instruction(instruction::_FJLE, j.arg2, j.arg1, target));
+    else if (rel == instruction::_LE)
+      out.push_back(instruction(instruction::_FJLT, j.arg2, j.arg1, target));
+    else
+      out.push_back(instruction(instruction::branch_on(rel, not negated), j.arg1, j.arg2, target));
+  }
+
+  // invert the conditional jumps over a goto, and rotate the loops
+  size_t invert_branches(FlowGraph &g) {
+    DataFlow df(g);
+    vector<size_t> next = next_blocks(g);
+    vector<bool> touched(g.num_blocks(), false);
+    size_t count = 0;
+    size_t def;
+
+    // "ifFalse c goto L1; goto L2; label L1" -> "if c goto L2; label L1"
+    for (size_t a = 0; a < g.num_blocks(); ++a) {
+      const basicBlock &ba = g.block(a);
+      const instruction *last = ba.last();
+      if (ba.removed or touched[a] or not last or not last->is_cond_jump()) continue;
+      size_t b = ba.fallthrough, l1 = g.jump_target(a);
+      if (b == NONE or l1 == NONE or next[a] != b or touched[b] or next[b] != l1) continue;
+      const basicBlock &bb = g.block(b);
+      if (bb.preds.size() != 1 or body_size(bb) != 1 or bb.last()->oper != instruction::_UJUMP)
+        continue;
+      size_t l2 = g.jump_target(b);
+      if (l2 == NONE or l2 == b or not invertible(g, df, a, def)) continue;
+      arenaVector<instruction> code;
+      invert(ba.instrs, 0, def, bb.last()->jump_label(), code);
+      g.block(a).instrs.swap(code);
+      g.block(a).fallthrough = l1;
+      g.block(b).removed = true;
+      touched[a] = touched[b] = true;
+      ++count;
+    }
+
+    // the latch ends with the inverted test of the header, instead of
+    // a goto to it
+    for (const FlowGraph::loop &l : g.loops()) {
+      size_t h = l.header;
+      const basicBlock &bh = g.block(h);
+      const instruction *last = bh.last();
+      if (touched[h] or l.latches.size() != 1 or not last or not last->is_cond_jump()) continue;
+      size_t e = g.jump_target(h), f = bh.fallthrough, t = l.latches[0];
+      if (e == NONE or l.contains(e) or f == NONE or not l.contains(f) or
+          t == h or touched[t] or touched[f])
+        continue;
+      const basicBlock &bt = g.block(t);
+      if (bt.last()->oper != instruction::_UJUMP or g.jump_target(t) != h or next[t] != e) continue;
+      if (body_size(bh) - 1 > CFGSimplify::ROTATE_LIMIT or not invertible(g, df, h, def)) continue;
+      operand lab = g.ensure_label(f);
+      arenaVector<instruction> code;
+      invert(bh.instrs, bh.label().empty() ? 0 : 1, def, lab, code);
+      basicBlock &latch = g.block(t);
+      latch.instrs.pop_back();
+      latch.instrs.insert(latch.instrs.end(), code.begin(), code.end());
+      latch.fallthrough = e;
+      touched[h] = touched[t] = touched[f] = true;
+      ++count;
+    }
+    return count;
+  }
+
+  // remove the labels that no jump uses
+  size_t remove_labels(FlowGraph &g) {
+    set<uint32_t> used;
+    for (size_t b = 0; b < g.num_blocks(); ++b) {
+      const instruction *last = g.block(b).last();
+      if (not g.block(b).removed and last and last->is_jump())
+        used.insert(last->jump_label().id());
+    }
+    size_t count = 0;
+    for (size_t b = 0; b < g.num_blocks(); ++b) {
+      basicBlock &bb = g.block(b);
+      operand lab = bb.label();
+      if (bb.removed or lab.empty() or used.count(lab.id())) continue;
+      bb.instrs.erase(bb.instrs.begin());
+      ++count;
+    }
+    return count;
+  }
+
+}
+
+// simplify the flow graph of s; returns how many changes were made
+size_t CFGSimplify::run(subroutine &s) {
+  FlowGraph g(s);
+  size_t count = 0;
+  for (unsigned round = 0; round < MAX_ROUNDS; ++round) {
+    size_t changes = remove_unreachable(g);
+    changes += thread_jumps(g);
+    changes += drop_jumps(g);
+    g.recompute_edges();
+    changes += merge_blocks(g);
+    g.recompute_edges();
+    changes += invert_branches(g);
+    g.recompute_edges();
+    count += changes;
+    if (changes == 0) break;
+  }
+  count += remove_labels(g);
+  if (count > 0) g.apply(s);
+  return count;
+}
@@ -0,0 +1,78 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CFGSimplify - Jump threading and simplification of the flow graph
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class CFGSimplify cleans up the jumps and labels that the code
+// generator and the other passes leave behind:
+//
+//  - blocks that cannot be reached are removed
+//  - jumps to a block that only jumps elsewhere (or is empty) go
+//    straight to the final target
+//  - a goto to the next block, and a conditional jump to the block
+//    it falls through to, are removed
+//  - a block is merged with its only successor when it is also the
+//    only predecessor of that block
+//  - a conditional jump over a goto is inverted:
+//
+//      ifFalse %c goto L1
+//      goto L2               becomes    (jump to L2 if %c is true)
+//    label L1 :
+//
+//  - the test of a loop whose header exits with a conditional jump
+//    is copied at the end of its latch, inverted, so that every
+//    iteration runs a conditional jump back instead of a goto to the
+//    header and the test (for headers of up to ROTATE_LIMIT
+//    instructions)
+//  - labels that no jump uses are removed
+//
+// The VM has no "jump if true", so a jump is inverted only when its
+// condition can be negated in place: the integer comparisons < and
+// <= (swapping their operands), a "not" (reading its operand instead),
+// and the compare-and-branch instructions except the float < and <=.
+// The condition must be computed in the same block and read only by
+// the jump.
+
+class CFGSimplify {
+
+public:
+
+  // simplify the flow graph of s; returns how many changes were made
+  static std::size_t run(subroutine &s);
+
+  // most instructions (besides the jump) copied to rotate a loop
+  static const std::size_t ROTATE_LIMIT = 4;
+};
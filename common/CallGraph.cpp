@@ -0,0 +1,183 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CallGraph - Calls between the subroutines of the code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+
+#include "CallGraph.h"
+
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'CallGraph'
+
+namespace {
+
+  const string ENTRY = "main";
+
+  // Tarjan's algorithm: components are closed callees first
+  class tarjan {
+  public:
+    tarjan(const vector<vector<size_t>> &succs,
+           vector<vector<size_t>> &sccs, vector<size_t> &sccOf)
+      : succs(succs), sccs(sccs), sccOf(sccOf), counter(0),
+        order(succs.size(), CallGraph::NONE), low(succs.size(), 0),
+        onStack(succs.size(), false) {
+      for (size_t f = 0; f < succs.size(); ++f)
+        if (order[f] == CallGraph::NONE) visit(f);
+    }
+
+  private:
+    const vector<vector<size_t>> &succs;
+    vector<vector<size_t>> &sccs;
+    vector<size_t> &sccOf;
+    size_t counter;
+    vector<size_t> order, low;
+    vector<bool> onStack;
+    vector<size_t> stack;
+
+    void visit(size_t f) {
+      order[f] = low[f] = counter++;
+      stack.push_back(f);
+      onStack[f] = true;
+      for (size_t g : succs[f]) {
+        if (order[g] == CallGraph::NONE) {
+          visit(g);
+          low[f] = min(low[f], low[g]);
+        }
+        else if (onStack[g]) low[f] = min(low[f], order[g]);
+      }
+      if (low[f] != order[f]) return;
+      // f is the root of a component: the subroutines above it
+      sccs.emplace_back();
+      size_t g;
+      do {
+        g = stack.back();
+        stack.pop_back();
+        onStack[g] = false;
+        sccOf[g] = sccs.size() - 1;
+        sccs.back().push_back(g);
+      } while (g != f);
+      sort(sccs.back().begin(), sccs.back().end());
+    }
+  };
+
+}
+
+
+const size_t CallGraph::NONE;
+
+CallGraph::CallGraph(const code &c) {
+  constSpan<subroutine> subs = c.get_subroutine_list();
+  size_t n = subs.size();
+  for (size_t f = 0; f < n; ++f) {
+    names.push_back(subs[f].get_name());
+    indexes[names.back()] = f;
+  }
+  succs.resize(n);
+  preds.resize(n);
+  calls.assign(n, 0);
+  selfCall.assign(n, false);
+  for (size_t f = 0; f < n; ++f) {
+    for (const instruction &i : subs[f].get_instructions()) {
+      if (i.oper != instruction::_CALL) continue;
+      ++calls[f];
+      size_t g = callee(i);
+      if (g == NONE) continue;
+      succs[f].push_back(g);
+      if (g == f) selfCall[f] = true;
+    }
+    sort(succs[f].begin(), succs[f].end());
+    succs[f].erase(unique(succs[f].begin(), succs[f].end()), succs[f].end());
+    for (size_t g : succs[f]) preds[g].push_back(f);
+  }
+  compute_reachable();
+  compute_components();
+}
+
+size_t CallGraph::num_subroutines() const { return names.size(); }
+
+const string & CallGraph::name(size_t f) const { return names[f]; }
+
+size_t CallGraph::index(const string &name) const {
+  auto it = indexes.find(name);
+  return it == indexes.end() ? NONE : it->second;
+}
+
+size_t CallGraph::callee(const instruction &i) const {
+  if (i.oper != instruction::_CALL) return NONE;
+  return index(i.arg1.to_string());
+}
+
+size_t CallGraph::entry() const { return index(ENTRY); }
+
+const vector<size_t> & CallGraph::callees(size_t f) const { return succs[f]; }
+
+const vector<size_t> & CallGraph::callers(size_t f) const { return preds[f]; }
+
+size_t CallGraph::num_calls(size_t f) const { return calls[f]; }
+
+bool CallGraph::reachable(size_t f) const { return fromEntry[f]; }
+
+size_t CallGraph::num_components() const { return sccs.size(); }
+
+const vector<size_t> & CallGraph::component(size_t c) const { return sccs[c]; }
+
+size_t CallGraph::component_of(size_t f) const { return sccOf[f]; }
+
+bool CallGraph::recursive(size_t f) const {
+  return selfCall[f] or sccs[sccOf[f]].size() > 1;
+}
+
+// depth first search from the entry
+void CallGraph::compute_reachable() {
+  fromEntry.assign(names.size(), false);
+  size_t e = entry();
+  if (e == NONE) return;
+  vector<size_t> pending(1, e);
+  fromEntry[e] = true;
+  while (not pending.empty()) {
+    size_t f = pending.back();
+    pending.pop_back();
+    for (size_t g : succs[f])
+      if (not fromEntry[g]) {
+        fromEntry[g] = true;
+        pending.push_back(g);
+      }
+  }
+}
+
+void CallGraph::compute_components() {
+  sccs.clear();
+  sccOf.assign(names.size(), NONE);
+  tarjan search(succs, sccs, sccOf);
+}
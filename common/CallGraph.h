@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CallGraph - Calls between the subroutines of the code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class CallGraph records which subroutines each subroutine calls
+// (the 'call' instructions of its code). Subroutines are numbered by
+// their position in the code.
+//
+// It also finds the subroutines reachable from the entry ("main")
+// and the strongly connected components of the graph (Tarjan): the
+// subroutines of a component call each other, so they are recursive
+// if the component has more than one, or if the only one calls
+// itself. Components are numbered callees first: a subroutine only
+// calls subroutines of its own component or of lower ones.
+//
+// Calls to names that are not subroutines of the code are ignored.
+// The graph is not updated when the code changes: build it again.
+
+class CallGraph {
+
+public:
+
+  static const std::size_t NONE = std::size_t(-1);
+
+  // build the graph of the given code
+  CallGraph(const code &c);
+
+  std::size_t num_subroutines() const;
+  const std::string & name(std::size_t f) const;
+  // position of the subroutine (NONE if there is none with that name)
+  std::size_t index(const std::string &name) const;
+  // subroutine called by a call instruction (NONE if unknown)
+  std::size_t callee(const instruction &i) const;
+  // the entry, "main" (NONE if the code has none)
+  std::size_t entry() const;
+
+  // subroutines called by f / calling f, sorted and without repetitions
+  const std::vector<std::size_t> & callees(std::size_t f) const;
+  const std::vector<std::size_t> & callers(std::size_t f) const;
+  // number of call instructions of f
+  std::size_t num_calls(std::size_t f) const;
+
+  // true if f may be called, directly or not, from the entry
+  bool reachable(std::size_t f) const;
+
+  // strongly connected components, callees first
+  std::size_t num_components() const;
+  const std::vector<std::size_t> & component(std::size_t c) const;
+  std::size_t component_of(std::size_t f) const;
+  // true if f may call itself, directly or not
+  bool recursive(std::size_t f) const;
+
+private:
+
+  std::vector<std::string> names;
+  std::map<std::string, std::size_t> indexes;
+  std::vector<std::vector<std::size_t>> succs, preds;
+  std::vector<std::size_t> calls;
+  std::vector<bool> fromEntry;
+  std::vector<std::vector<std::size_t>> sccs;
+  std::vector<std::size_t> sccOf;
+  std::vector<bool> selfCall;
+
+  void compute_reachable();
+  void compute_components();
+};
@@ -0,0 +1,351 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CodeSerializer - Binary container for t-code programs
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "CodeSerializer.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+
+using namespace std;
+using namespace tcodebin;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'CodeSerializer'
+
+namespace {
+  // string table of the file being written. Strings are numbered in
+  // the order they are added, so output does not depend on the
+  // order of the intern table of the compilation unit.
+  class stringPool {
+  public:
+    uint32_t add(const string &s) {
+      auto it = index.find(s);
+      if (it != index.end()) return it->second;
+      uint32_t id = strings.size();
+      binString bs;
+      bs.offset = data.size();
+      bs.length = s.size();
+      strings.push_back(bs);
+      data.append(s);
+      data.push_back('\0');
+      index.insert(make_pair(s, id));
+      return id;
+    }
+    vector<binString> strings;
+    string data;
+  private:
+    unordered_map<string, uint32_t> index;
+  };
+
+  // operand encoded with an id of the file string table
+  uint32_t encode(const operand &o, stringPool &pool) {
+    uint32_t id;
+    if (o.empty()) id = 0;
+    else if (o.is_temp()) id = o.id();
+    else id = pool.add(o.to_string());
+    return (uint32_t(o.kind()) << operand::KIND_SHIFT) | (id & operand::ID_MASK);
+  }
+
+  // append a table of plain records to the output
+  template <class T>
+  void append(string &out, const vector<T> &v) {
+    if (not v.empty())
+      out.append(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+  }
+
+  void pad4(string &out) {
+    while (out.size() % 4) out.push_back('\0');
+  }
+}
+
+// serialize the code into a byte string
+string CodeSerializer::serialize(const code &c) {
+  stringPool pool;
+  vector<binFunction> funcs;
+  vector<binVar> vars;
+  vector<binInstruction> instrs;
+
+  for (auto &s : c.get_subroutine_list()) {
+    binFunction f;
+    memset(&f, 0, sizeof(f));
+    f.name = pool.add(s.get_name());
+
+    f.firstParam = vars.size();
+    for (auto &p : s.params) {
+      binVar v = {pool.add(p.name), pool.add(p.type), 0, VAR_PARAM};
+      vars.push_back(v);
+    }
+    f.numParams = vars.size() - f.firstParam;
+
+    f.firstVar = vars.size();
+    for (auto &l : s.vars) {
+      binVar v = {pool.add(l.name), pool.add(l.type), uint32_t(l.nelem), 0};
+      vars.push_back(v);
+    }
+    f.numVars = vars.size() - f.firstVar;
+
+    f.firstInstr = instrs.size();
+    for (auto &i : s.get_instructions()) {
+      binInstruction b;
+      memset(&b, 0, sizeof(b));
+      b.oper = uint8_t(i.oper);
+      b.arg[0] = encode(i.arg1, pool);
+      b.arg[1] = encode(i.arg2, pool);
+      b.arg[2] = encode(i.arg3, pool);
+      b.target = i.target;
+      instrs.push_back(b);
+    }
+    f.numInstrs = instrs.size() - f.firstInstr;
+    funcs.push_back(f);
+  }
+
+  binHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(h.magic));
+  h.version = VERSION;
+  h.byteOrder = ENDIAN_MARK;
+  h.numFunctions = funcs.size();
+  h.numVars = vars.size();
+  h.numInstrs = instrs.size();
+  h.numStrings = pool.strings.size();
+  h.functionsOffset = sizeof(binHeader);
+  h.varsOffset = h.functionsOffset + funcs.size() * sizeof(binFunction);
+  h.instrsOffset = h.varsOffset + vars.size() * sizeof(binVar);
+  h.stringsOffset = h.instrsOffset + instrs.size() * sizeof(binInstruction);
+  h.stringDataOffset = h.stringsOffset + pool.strings.size() * sizeof(binString);
+
+  string out;
+  out.reserve(h.stringDataOffset + pool.data.size() + 4);
+  out.append(reinterpret_cast<const char *>(&h), sizeof(h));
+  append(out, funcs);
+  append(out, vars);
+  append(out, instrs);
+  append(out, pool.strings);
+  out.append(pool.data);
+  pad4(out);
+
+  // the total size is only known now
+  uint32_t fileSize = out.size();
+  memcpy(&out[offsetof(binHeader, fileSize)], &fileSize, sizeof(fileSize));
+  return out;
+}
+
+// serialize the code into the given stream
+void CodeSerializer::write(const code &c, std::ostream &out) {
+  string bytes = serialize(c);
+  out.write(bytes.data(), bytes.size());
+}
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'MappedCode'
+
+MappedCode::MappedCode() : base(nullptr), size(0) {}
+MappedCode::~MappedCode() { unload(); }
+
+// release the mapping (if any)
+void MappedCode::unload() {
+  if (base) munmap(const_cast<char *>(base), size);
+  base = nullptr;
+  size = 0;
+}
+
+// reason of the last failure of load
+const string & MappedCode::error() const { return lastError; }
+
+bool MappedCode::fail(const string &msg) {
+  lastError = msg;
+  unload();
+  return false;
+}
+
+// map the given file and check it
+bool MappedCode::load(const std::string &fileName) {
+  unload();
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) return fail("cannot open " + fileName);
+  struct stat st;
+  if (fstat(fd, &st) != 0 or st.st_size < off_t(sizeof(binHeader))) {
+    close(fd);
+    return fail(fileName + " is not a binary t-code file");
+  }
+  void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);   // the mapping stays valid
+  if (p == MAP_FAILED) return fail("cannot map " + fileName);
+  base = static_cast<const char *>(p);
+  size = st.st_size;
+  return check();
+}
+
+// check that header and tables are consistent with the mapped size,
+// so accessors need no further checks
+bool MappedCode::check() {
+  const binHeader &h = header();
+  if (memcmp(h.magic, MAGIC, sizeof(h.magic)) != 0)
+    return fail("not a binary t-code file");
+  if (h.byteOrder != ENDIAN_MARK)
+    return fail("binary t-code written with a different byte order");
+  if (h.version != VERSION)
+    return fail("unsupported binary t-code version " + to_string(h.version));
+  if (h.fileSize != size)
+    return fail("truncated binary t-code file");
+
+  auto inside = [this](uint64_t offset, uint64_t n, uint64_t recSize) {
+    return offset % 4 == 0 and offset + n * recSize <= size;
+  };
+  if (not inside(h.functionsOffset, h.numFunctions, sizeof(binFunction)) or
+      not inside(h.varsOffset, h.numVars, sizeof(binVar)) or
+      not inside(h.instrsOffset, h.numInstrs, sizeof(binInstruction)) or
+      not inside(h.stringsOffset, h.numStrings, sizeof(binString)) or
+      h.stringDataOffset > size)
+    return fail("corrupted binary t-code tables");
+
+  uint64_t dataSize = size - h.stringDataOffset;
+  const binString *strs = reinterpret_cast<const binString *>(base + h.stringsOffset);
+  for (uint32_t i = 0; i < h.numStrings; ++i) {
+    if (uint64_t(strs[i].offset) + strs[i].length >= dataSize or
+        base[h.stringDataOffset + strs[i].offset + strs[i].length] != '\0')
+      return fail("corrupted binary t-code string table");
+  }
+
+  auto validString = [&h](uint32_t idx) { return idx < h.numStrings; };
+  const binFunction *fs = functions();
+  for (uint32_t i = 0; i < h.numFunctions; ++i) {
+    const binFunction &f = fs[i];
+    if (not validString(f.name) or
+        uint64_t(f.firstParam) + f.numParams > h.numVars or
+        uint64_t(f.firstVar) + f.numVars > h.numVars or
+        uint64_t(f.firstInstr) + f.numInstrs > h.numInstrs)
+      return fail("corrupted binary t-code function table");
+    // jumps must land on the label they name, in the same function,
+    // and labels must be unique (to_code resolves them by name)
+    const binInstruction *is = instructions() + f.firstInstr;
+    unordered_map<uint32_t, uint32_t> labels;
+    for (uint32_t k = 0; k < f.numInstrs; ++k)
+      if (is[k].oper == instruction::_LABEL and
+          not labels.insert(make_pair(is[k].arg[0], k)).second)
+        return fail("label defined twice in binary t-code");
+    auto file_operand = [](uint32_t raw) {
+      return operand::make(operand::Kind(raw >> operand::KIND_SHIFT), raw & operand::ID_MASK);
+    };
+    for (uint32_t k = 0; k < f.numInstrs; ++k) {
+      if (is[k].oper >= instruction::_INVALID) continue;
+      instruction i(instruction::Operation(is[k].oper), file_operand(is[k].arg[0]),
+                    file_operand(is[k].arg[1]), file_operand(is[k].arg[2]));
+      if (not i.is_jump()) continue;
+      const operand &lab = i.jump_label();
+      auto it = labels.find((uint32_t(lab.kind()) << operand::KIND_SHIFT) | lab.id());
+      if (it == labels.end() or it->second != is[k].target)
+        return fail("unresolved jump in binary t-code");
+    }
+  }
+  const binVar *vs = vars();
+  for (uint32_t i = 0; i < h.numVars; ++i)
+    if (not validString(vs[i].name) or not validString(vs[i].type))
+      return fail("corrupted binary t-code var table");
+  const binInstruction *is = instructions();
+  for (uint32_t i = 0; i < h.numInstrs; ++i) {
+    if (is[i].oper >= instruction::_INVALID)
+      return fail("invalid operation in binary t-code");
+    for (uint32_t raw : is[i].arg) {
+      operand::Kind k = operand::Kind(raw >> operand::KIND_SHIFT);
+      if (k > operand::_STRING or
+          (k != operand::_NONE and k != operand::_TEMP and not validString(raw & operand::ID_MASK)))
+        return fail("invalid operand in binary t-code");
+    }
+  }
+  return true;
+}
+
+// direct access to the mapped tables
+const binHeader & MappedCode::header() const {
+  return *reinterpret_cast<const binHeader *>(base);
+}
+const binFunction * MappedCode::functions() const {
+  return reinterpret_cast<const binFunction *>(base + header().functionsOffset);
+}
+const binVar * MappedCode::vars() const {
+  return reinterpret_cast<const binVar *>(base + header().varsOffset);
+}
+const binInstruction * MappedCode::instructions() const {
+  return reinterpret_cast<const binInstruction *>(base + header().instrsOffset);
+}
+const char * MappedCode::string_at(uint32_t idx) const {
+  const binString *strs = reinterpret_cast<const binString *>(base + header().stringsOffset);
+  return base + header().stringDataOffset + strs[idx].offset;
+}
+
+// index of the function with given name
+uint32_t MappedCode::find_function(const std::string &name) const {
+  const binFunction *fs = functions();
+  uint32_t n = header().numFunctions;
+  for (uint32_t i = 0; i < n; ++i)
+    if (name == string_at(fs[i].name)) return i;
+  return n;
+}
+
+// operand of the compilation unit for a raw operand of the file
+operand MappedCode::get_operand(uint32_t raw) const {
+  operand::Kind k = operand::Kind(raw >> operand::KIND_SHIFT);
+  uint32_t id = raw & operand::ID_MASK;
+  if (k == operand::_NONE or k == operand::_TEMP) return operand::make(k, id);
+  return operand::make(k, operand::intern(string_at(id)));
+}
+
+// rebuild a code object from the mapped file
+code MappedCode::to_code() const {
+  code c;
+  if (not base) return c;
+  const binFunction *fs = functions();
+  const binVar *vs = vars();
+  const binInstruction *is = instructions();
+  for (uint32_t i = 0; i < header().numFunctions; ++i) {
+    const binFunction &f = fs[i];
+    c.add_subroutine(subroutine(string_at(f.name)));
+    subroutine &s = c.get_last_subroutine();
+    for (uint32_t p = f.firstParam; p < f.firstParam + f.numParams; ++p)
+      s.params.push_back(var(string_at(vs[p].name), string_at(vs[p].type), 0));
+    for (uint32_t v = f.firstVar; v < f.firstVar + f.numVars; ++v)
+      s.add_var(string_at(vs[v].name), string_at(vs[v].type), vs[v].nelem);
+    instructionList code;
+    for (uint32_t k = f.firstInstr; k < f.firstInstr + f.numInstrs; ++k)
+      code = code || instruction(instruction::Operation(is[k].oper),
+                                 get_operand(is[k].arg[0]),
+                                 get_operand(is[k].arg[1]),
+                                 get_operand(is[k].arg[2]));
+    s.set_instructions(code);
+  }
+  return c;
+}
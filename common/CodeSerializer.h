@@ -0,0 +1,171 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CodeSerializer - Binary container for t-code programs
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Layout of a binary t-code file. All fields are 32-bit words in
+// the byte order of the machine that wrote the file (checked with
+// 'byteOrder'), and every section starts 4-byte aligned, so that
+// the file can be used right after being mapped in memory:
+//
+//   header
+//   function table   numFunctions x binFunction
+//   var table        numVars      x binVar   (params and locals)
+//   instructions     numInstrs    x binInstruction
+//   string table     numStrings   x binString
+//   string data      NUL-terminated texts
+//
+// Operands keep the kind/id encoding of class operand, but ids of
+// names, labels and literals are indexes in the string table of the
+// file (temporals keep their number).
+
+namespace tcodebin {
+
+  static const char     MAGIC[4]   = {'T', 'V', 'M', 'B'};
+  static const uint32_t VERSION    = 4;
+  static const uint32_t ENDIAN_MARK = 0x01020304;
+
+  struct binHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t fileSize;
+    uint32_t numFunctions, functionsOffset;
+    uint32_t numVars,      varsOffset;
+    uint32_t numInstrs,    instrsOffset;
+    uint32_t numStrings,   stringsOffset;
+    uint32_t stringDataOffset;
+    uint32_t reserved;
+  };
+
+  struct binFunction {
+    uint32_t name;                   // index in the string table
+    uint32_t firstParam, numParams;  // slice of the var table
+    uint32_t firstVar,   numVars;    // slice of the var table
+    uint32_t firstInstr, numInstrs;  // slice of the instructions
+    uint32_t reserved;
+  };
+
+  struct binVar {
+    uint32_t name;   // index in the string table
+    uint32_t type;   // index in the string table ("integer", "float array"...)
+    uint32_t nelem;  // 0 for parameters
+    uint32_t flags;  // VAR_PARAM
+  };
+  static const uint32_t VAR_PARAM = 1;
+
+  struct binInstruction {
+    uint8_t  oper;         // instruction::Operation
+    uint8_t  reserved[3];
+    uint32_t arg[3];       // kind << 28 | id
+    uint32_t target;       // jumps: position of the target label in
+                           // the function (instruction::NO_TARGET otherwise)
+  };
+
+  struct binString {
+    uint32_t offset;       // from the beginning of the string data
+    uint32_t length;       // without the final NUL
+  };
+
+  static_assert(sizeof(binHeader) == 56,      "unexpected binHeader layout");
+  static_assert(sizeof(binFunction) == 32,    "unexpected binFunction layout");
+  static_assert(sizeof(binVar) == 16,         "unexpected binVar layout");
+  static_assert(sizeof(binInstruction) == 20, "unexpected binInstruction layout");
+  static_assert(sizeof(binString) == 8,       "unexpected binString layout");
+}
+
+
+////////////////////////////////////////////////////////////////
+// Class CodeSerializer writes a whole program in the binary format.
+// Strings are numbered in the order they are found, so that the
+// same program always produces the same bytes.
+
+class CodeSerializer {
+public:
+  // serialize the code into a byte string
+  static std::string serialize(const code &c);
+  // serialize the code into the given stream
+  static void write(const code &c, std::ostream &out);
+};
+
+
+////////////////////////////////////////////////////////////////
+// Class MappedCode maps a binary t-code file in memory with a single
+// mmap and gives direct access to its tables, without any parsing
+// (asl --load turns the file back into code this way).
+// The mapping is released when the object is destroyed.
+
+class MappedCode {
+public:
+  MappedCode();
+  ~MappedCode();
+  MappedCode(const MappedCode &) = delete;
+  MappedCode & operator=(const MappedCode &) = delete;
+
+  // map the given file and check its header and tables.
+  // On failure, returns false and error() tells why.
+  bool load(const std::string &fileName);
+  // release the mapping (if any)
+  void unload();
+  // reason of the last failure of load
+  const std::string & error() const;
+
+  // direct access to the mapped tables
+  const tcodebin::binHeader & header() const;
+  const tcodebin::binFunction * functions() const;
+  const tcodebin::binVar * vars() const;
+  const tcodebin::binInstruction * instructions() const;
+  // text of the string with given index (NUL-terminated)
+  const char * string_at(uint32_t idx) const;
+  // index of the function with given name (numFunctions if not found)
+  uint32_t find_function(const std::string &name) const;
+
+  // rebuild a code object from the mapped file (names are interned
+  // in the table of the current compilation unit)
+  code to_code() const;
+
+private:
+  const char *base;
+  std::size_t size;
+  std::string lastError;
+
+  bool fail(const std::string &msg);
+  bool check();
+  operand get_operand(uint32_t raw) const;
+};
@@ -0,0 +1,358 @@
+/////////////////////////////////////////////////////////////////
+//
+//    ConstFold - Constant folding and propagation on t-code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "ConstFold.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <string>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'ConstFold'
+
+namespace {
+
+  const size_t NONE = FlowGraph::NONE;
+
+  // lattice of values: not known yet, a constant, or not a constant
+  struct value {
+    enum State { UNDEF, INT, FLOAT, NAC } state;
+    int32_t i;
+    float f;
+
+    value(State s = UNDEF) : state(s), i(0), f(0) {}
+    static value of_int(int64_t x) { value v(INT); v.i = int32_t(x); return v; }
+    static value of_float(float x) { value v(FLOAT); v.f = x; return v; }
+    bool is_const() const { return state == INT or state == FLOAT; }
+
+    bool operator==(const value &o) const {
+      if (state != o.state) return false;
+      if (state == INT) return i == o.i;
+      if (state == FLOAT) return memcmp(&f, &o.f, sizeof f) == 0;
+      return true;
+    }
+    bool operator!=(const value &o) const { return not (*this == o); }
+  };
+
+  value meet(const value &a, const value &b) {
+    if (a.state == value::UNDEF) return b;
+    if (b.state == value::UNDEF) return a;
+    if (a == b) return a;
+    return value(value::NAC);
+  }
+
+  // value of a literal operand
+  value literal(const operand &o) {
+    const string &text = o.to_string();
+    switch (o.kind()) {
+    case operand::_INT: {
+      char *end;
+      long long x = strtoll(text.c_str(), &end, 10);
+      if (*end or x < INT_MIN or x > INT_MAX) return value(value::NAC);
+      return value::of_int(x);
+    }
+    case operand::_FLOAT: {
+      char *end;
+      float x = strtof(text.c_str(), &end);
+      if (*end) return value(value::NAC);
+      return value::of_float(x);
+    }
+    case operand::_CHAR:
+      if (text.size() == 1) return value::of_int((unsigned char)text[0]);
+      if (text.size() == 2 and text[0] == '\\') {
+        switch (text[1]) {
+        case 'n':  return value::of_int('\n');
+        case 't':  return value::of_int('\t');
+        case '\\': return value::of_int('\\');
+        case '\'': return value::of_int('\'');
+        case '"':  return value::of_int('"');
+        }
+      }
+      return value(value::NAC);
+    default:
+      return value(value::NAC);
+    }
+  }
+
+  // true for the instructions whose result can be folded
+  bool foldable(instruction::Operation op) {
+    switch (op) {
+    case instruction::_ADD: case instruction::_SUB: case instruction::_MUL:
+    case instruction::_DIV: case instruction::_EQ:  case instruction::_LT:
+    case instruction::_LE:  case instruction::_NEG: case instruction::_NOT:
+    case instruction::_AND: case instruction::_OR:  case instruction::_FLOAT:
+    case instruction::_FADD: case instruction::_FSUB: case instruction::_FMUL:
+    case instruction::_FDIV: case instruction::_FEQ:  case instruction::_FLT:
+    case instruction::_FLE:  case instruction::_FNEG: case instruction::_LOAD:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  // result of a foldable instruction, given the values of its operands
+  value evaluate(instruction::Operation op, const value &a, const value &b, bool binary) {
+    if (a.state == value::NAC or (binary and b.state == value::NAC)) return value(value::NAC);
+    if (a.state == value::UNDEF or (binary and b.state == value::UNDEF)) return value();
+    if (op == instruction::_LOAD) return a;
+
+    bool ints = a.state == value::INT and (not binary or b.state == value::INT);
+    bool floats = a.state == value::FLOAT and (not binary or b.state == value::FLOAT);
+    uint32_t x = a.i, y = b.i;
+    switch (op) {
+    case instruction::_ADD: if (ints) return value::of_int(int32_t(x + y)); break;
+    case instruction::_SUB: if (ints) return value::of_int(int32_t(x - y)); break;
+    case instruction::_MUL: if (ints) return value::of_int(int32_t(x * y)); break;
+    case instruction::_DIV:
+      // these would stop the VM: let it happen at run time
+      if (ints and b.i != 0 and not (a.i == INT_MIN and b.i == -1))
+        return value::of_int(a.i / b.i);
+      break;
+    case instruction::_EQ:  if (ints) return value::of_int(a.i == b.i); break;
+    case instruction::_LT:  if (ints) return value::of_int(a.i < b.i); break;
+    case instruction::_LE:  if (ints) return value::of_int(a.i <= b.i); break;
+    case instruction::_NEG: if (ints) return value::of_int(int32_t(0u - x)); break;
+    case instruction::_NOT: if (ints) return value::of_int(a.i == 0); break;
+    case instruction::_AND: if (ints) return value::of_int(a.i != 0 and b.i != 0); break;
+    case instruction::_OR:  if (ints) return value::of_int(a.i != 0 or b.i != 0); break;
+    case instruction::_FLOAT: if (ints) return value::of_float(float(a.i)); break;
+    case instruction::_FADD: if (floats) return value::of_float(a.f + b.f); break;
+    case instruction::_FSUB: if (floats) return value::of_float(a.f - b.f); break;
+    case instruction::_FMUL: if (floats) return value::of_float(a.f * b.f); break;
+    case instruction::_FDIV: if (floats) return value::of_float(a.f / b.f); break;
+    case instruction::_FEQ:  if (floats) return value::of_int(a.f == b.f); break;
+    case instruction::_FLT:  if (floats) return value::of_int(a.f < b.f); break;
+    case instruction::_FLE:  if (floats) return value::of_int(a.f <= b.f); break;
+    case instruction::_FNEG: if (floats) return value::of_float(-a.f); break;
+    default: break;
+    }
+    return value(value::NAC);
+  }
+
+  // text of a non-negative float that reads back as the same float
+  // (the VM does not accept exponents, so the fixed notation is used)
+  bool float_text(float x, string &text) {
+    if (not std::isfinite(x) or std::signbit(x)) return false;
+    char buf[128];
+    for (int prec = 1; prec <= 60; ++prec) {
+      snprintf(buf, sizeof buf, "%.*f", prec, double(x));
+      if (strtof(buf, nullptr) == x and float(strtod(buf, nullptr)) == x) {
+        text = buf;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // instructions that load the constant v into d (empty if v cannot
+  // be written as a literal)
+  vector<instruction> load_constant(const operand &d, const value &v) {
+    vector<instruction> code;
+    if (v.state == value::INT) {
+      if (v.i == INT_MIN) return code;
+      code.push_back(instruction(instruction::_ILOAD, d, operand(operand::_INT, std::to_string(std::abs(v.i)))));
+      if (v.i < 0) code.push_back(instruction(instruction::_NEG, d, d));
+    }
+    else if (v.state == value::FLOAT) {
+      string text;
+      if (not float_text(std::fabs(v.f), text)) return code;
+      code.push_back(instruction(instruction::_FLOAD, d, operand(operand::_FLOAT, text)));
+      if (std::signbit(v.f)) code.push_back(instruction(instruction::_FNEG, d, d));
+    }
+    return code;
+  }
+
+  bool is_constant_load(const instruction &i) {
+    return (i.oper == instruction::_ILOAD or i.oper == instruction::_FLOAD or
+            i.oper == instruction::_CHLOAD) and i.arg2.is_literal();
+  }
+
+  // value of an operand in the given state
+  value value_of(const operand &o, const DataFlow &df, const vector<value> &state) {
+    if (o.is_literal()) return literal(o);
+    if (not o.is_address()) return value(value::NAC);
+    return state[df.var_index(o)];
+  }
+
+  // value computed by instruction i (NAC if it is not foldable)
+  value computed(const instruction &i, const DataFlow &df, const vector<value> &state) {
+    if (is_constant_load(i)) return literal(i.arg2);
+    if (not foldable(i.oper)) return value(value::NAC);
+    bool binary = not i.arg3.empty();
+    value a = value_of(i.arg2, df, state);
+    value b = binary ? value_of(i.arg3, df, state) : value();
+    return evaluate(i.oper, a, b, binary);
+  }
+
+  // value of the condition of the conditional jump j (it jumps when
+  // the condition is 0)
+  value condition(const instruction &j, const DataFlow &df, const vector<value> &state) {
+    if (j.oper == instruction::_FJUMP) return value_of(j.arg1, df, state);
+    bool negated;
+    instruction::Operation rel = instruction::branch_relation(j.oper, negated);
+    value c = evaluate(rel, value_of(j.arg1, df, state), value_of(j.arg2, df, state), true);
+    if (negated and c.state == value::INT) c.i = (c.i == 0);
+    return c;
+  }
+
+  // effect of instruction i on the state
+  void transfer(const instruction &i, const DataFlow &df, vector<value> &state) {
+    operand d = i.def();
+    if (not d.empty()) state[df.var_index(d)] = computed(i, df, state);
+  }
+
+}
+
+// fold the constants of s; returns how many instructions were
+// folded, resolved or deleted
+size_t ConstFold::run(subroutine &s) {
+  FlowGraph g(s);
+  DataFlow df(g);
+  size_t nb = g.num_blocks(), nv = df.num_vars();
+
+  // propagate values along the edges that can be taken: the condition
+  // of a jump, once known, tells which successor is executed
+  vector<vector<value>> in(nb, vector<value>(nv));
+  vector<bool> executable(nb, false), pending(nb, false);
+  in[0].assign(nv, value(value::NAC));      // params, and vars not initialized
+  executable[0] = pending[0] = true;
+  vector<size_t> work(1, 0);
+  while (not work.empty()) {
+    size_t b = work.back();
+    work.pop_back();
+    pending[b] = false;
+    const basicBlock &bb = g.block(b);
+    vector<value> state = in[b];
+    for (const instruction &i : bb.instrs) transfer(i, df, state);
+
+    vector<size_t> next;
+    const instruction *last = bb.last();
+    bool branches = last and last->is_cond_jump();
+    value cond;
+    if (branches) cond = condition(*last, df, state);
+    if (cond.state == value::INT)
+      next.push_back(cond.i == 0 ? g.jump_target(b) : bb.fallthrough);
+    else if (cond.state == value::NAC or not branches)
+      next = bb.succs;
+    // (a condition still undefined enables no edge yet)
+
+    for (size_t t : next) {
+      if (t >= nb) continue;     // exit node
+      bool changed = not executable[t];
+      executable[t] = true;
+      for (size_t v = 0; v < nv; ++v) {
+        value m = meet(in[t][v], state[v]);
+        if (m != in[t][v]) {
+          in[t][v] = m;
+          changed = true;
+        }
+      }
+      if (changed and not pending[t]) {
+        pending[t] = true;
+        work.push_back(t);
+      }
+    }
+  }
+
+  // rewrite the blocks
+  size_t count = 0;
+  for (size_t b = 0; b < nb; ++b) {
+    basicBlock &bb = g.block(b);
+    if (bb.removed) continue;
+    if (not executable[b]) {
+      count += bb.instrs.size();
+      bb.removed = true;
+      continue;
+    }
+    vector<value> state = in[b];
+    arenaVector<instruction> code;
+    for (const instruction &i : bb.instrs) {
+      if (i.is_cond_jump()) {
+        value cond = condition(i, df, state);
+        if (cond.state == value::INT) {
+          if (cond.i == 0) code.push_back(instruction(instruction::_UJUMP, i.jump_label()));
+          ++count;
+          continue;
+        }
+      }
+      value r = computed(i, df, state);
+      operand d = i.def();
+      transfer(i, df, state);
+      if (r.is_const() and foldable(i.oper)) {
+        vector<instruction> load = load_constant(d, r);
+        // a copy is only worth replacing by a single load
+        if (not load.empty() and (i.oper != instruction::_LOAD or load.size() == 1)) {
+          code.insert(code.end(), load.begin(), load.end());
+          ++count;
+          continue;
+        }
+      }
+      code.push_back(i);
+    }
+    bb.instrs.swap(code);
+  }
+  if (count == 0) return 0;
+  g.recompute_edges();
+
+  // delete the constant loads of temporals that are no longer read
+  DataFlow live(g);
+  for (size_t b = 0; b < nb; ++b) {
+    basicBlock &bb = g.block(b);
+    if (bb.removed) continue;
+    bitSet alive = live.live_out(b);
+    vector<bool> keep(bb.instrs.size(), true);
+    operand u[3];
+    for (size_t k = bb.instrs.size(); k-- > 0; ) {
+      const instruction &i = bb.instrs[k];
+      operand d = i.def();
+      if (is_constant_load(i) and d.is_temp() and not alive.test(live.var_index(d))) {
+        keep[k] = false;
+        ++count;
+        continue;
+      }
+      if (not d.empty()) alive.reset(live.var_index(d));
+      int n = i.uses(u);
+      for (int j = 0; j < n; ++j) alive.set(live.var_index(u[j]));
+    }
+    arenaVector<instruction> code;
+    for (size_t k = 0; k < bb.instrs.size(); ++k)
+      if (keep[k]) code.push_back(bb.instrs[k]);
+    bb.instrs.swap(code);
+  }
+  g.apply(s);
+  return count;
+}
@@ -0,0 +1,61 @@
+/////////////////////////////////////////////////////////////////
+//
+//    ConstFold - Constant folding and propagation on t-code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class ConstFold propagates the constants loaded with ILOAD, FLOAD
+// and CHLOAD through temporals, vars and copies, and replaces every
+// arithmetic, relational, logical or FLOAT instruction whose result
+// is known by a load of that result. Conditional jumps on a known
+// condition become gotos (or disappear), and blocks that can no
+// longer be reached are removed. Constant loads left without uses
+// are deleted.
+//
+// Folding follows the VM: integers are 32 bits and wrap around, the
+// division truncates, floats are single precision, and logical
+// operations give 0 or 1. A division that traps (by zero, or of
+// INT_MIN by -1) is left for the VM. Negative results are loaded as
+// their absolute value and negated, since the VM only reads
+// non-negative literals.
+
+class ConstFold {
+
+public:
+
+  // fold the constants of s; returns how many instructions were
+  // folded, resolved or deleted
+  static std::size_t run(subroutine &s);
+};
@@ -0,0 +1,219 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CopyProp - Copy propagation on t-code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "CopyProp.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'CopyProp'
+
+namespace {
+
+  // true if i copies an address operand into another one (not "x = x")
+  bool real_copy(const instruction &i) {
+    return i.is_copy() and i.arg1 != i.arg2;
+  }
+
+  bool mentions(const instruction &i, const operand &o) {
+    return i.arg1 == o or i.arg2 == o or i.arg3 == o;
+  }
+
+  // "%t = ...; d = %t" -> "d = ...", when %t has no other reader and
+  // d is not used in between. Returns how many copies were removed.
+  size_t coalesce(FlowGraph &g, DataFlow &df) {
+    size_t count = 0;
+    vector<bitSet> after;
+    for (size_t b = 0; b < g.num_blocks(); ++b) {
+      basicBlock &bb = g.block(b);
+      if (bb.removed) continue;
+      df.live_after(b, after);
+      vector<bool> keep(bb.instrs.size(), true);
+      size_t limit = 0;      // instructions before are already rewritten
+      for (size_t k = 0; k < bb.instrs.size(); ++k) {
+        const instruction &c = bb.instrs[k];
+        if (not real_copy(c) or not c.arg2.is_temp() or
+            after[k].test(df.var_index(c.arg2)))
+          continue;
+        const operand &d = c.arg1, &t = c.arg2;
+        // the definition of %t, with no use of %t or d after it
+        size_t j = k;
+        bool found = false;
+        while (j > limit and not found) {
+          const instruction &i = bb.instrs[--j];
+          if (i.def() == t) found = true;
+          else if (mentions(i, t) or mentions(i, d)) break;
+        }
+        if (not found) continue;
+        bb.instrs[j].arg1 = d;
+        keep[k] = false;
+        limit = k + 1;
+        ++count;
+      }
+      if (limit == 0) continue;
+      arenaVector<instruction> code;
+      for (size_t k = 0; k < bb.instrs.size(); ++k)
+        if (keep[k]) code.push_back(bb.instrs[k]);
+      bb.instrs.swap(code);
+      df.update_block(b);
+    }
+    return count;
+  }
+
+  // replace reads of d by s after every available copy "d = s"
+  size_t propagate(FlowGraph &g, DataFlow &df) {
+    size_t nb = g.num_blocks(), nv = df.num_vars();
+
+    // the copies of the subroutine, and the ones killed by writing each var
+    vector<operand> dst, src;
+    vector<vector<size_t>> killedBy(nv);
+    for (size_t b = 0; b < nb; ++b) {
+      if (g.block(b).removed) continue;
+      for (const instruction &i : g.block(b).instrs) {
+        if (not real_copy(i)) continue;
+        bool seen = false;
+        for (size_t c = 0; c < dst.size() and not seen; ++c)
+          seen = dst[c] == i.arg1 and src[c] == i.arg2;
+        if (seen) continue;
+        killedBy[df.var_index(i.arg1)].push_back(dst.size());
+        killedBy[df.var_index(i.arg2)].push_back(dst.size());
+        dst.push_back(i.arg1);
+        src.push_back(i.arg2);
+      }
+    }
+    size_t nc = dst.size();
+    if (nc == 0) return 0;
+    auto copy_of = [&](const instruction &i) {
+      size_t c = 0;
+      while (dst[c] != i.arg1 or src[c] != i.arg2) ++c;
+      return c;
+    };
+
+    // available copies (forward, intersection over the predecessors)
+    vector<bitSet> gen(nb, bitSet(nc)), kill(nb, bitSet(nc));
+    for (size_t b = 0; b < nb; ++b) {
+      if (g.block(b).removed) continue;
+      for (const instruction &i : g.block(b).instrs) {
+        operand d = i.def();
+        if (d.empty()) continue;
+        for (size_t c : killedBy[df.var_index(d)]) {
+          gen[b].reset(c);
+          kill[b].set(c);
+        }
+        if (real_copy(i)) gen[b].set(copy_of(i));
+      }
+    }
+    bitSet all(nc);
+    for (size_t c = 0; c < nc; ++c) all.set(c);
+    vector<bitSet> in(nb, all), out(nb, all);
+    const vector<size_t> &rpo = g.reverse_postorder();
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (size_t b : rpo) {
+        bitSet x = all;
+        if (b == 0) x.clear();
+        for (size_t p : g.block(b).preds)
+          if (g.reachable(p)) {
+            bitSet notOut = all;
+            notOut.subtract(out[p]);
+            x.subtract(notOut);
+          }
+        in[b] = x;
+        x.subtract(kill[b]);
+        x.unite(gen[b]);
+        if (x != out[b]) {
+          out[b] = x;
+          changed = true;
+        }
+      }
+    }
+
+    // rewrite the reads, keeping the copies available at each point
+    size_t count = 0;
+    for (size_t b : rpo) {
+      basicBlock &bb = g.block(b);
+      vector<operand> srcOf(nv);
+      vector<size_t> active;
+      in[b].for_each([&](size_t c) {
+          size_t v = df.var_index(dst[c]);
+          srcOf[v] = src[c];
+          active.push_back(v);
+        });
+      bool touched = false;
+      arenaVector<instruction> code;
+      for (instruction &i : bb.instrs) {
+        operand *u[3];
+        int n = i.use_slots(u);
+        for (int j = 0; j < n; ++j) {
+          const operand &s = srcOf[df.var_index(*u[j])];
+          if (s.empty() or (s.kind() == operand::_PARAM and i.is_address_slot(u[j])))
+            continue;
+          *u[j] = s;
+          touched = true;
+          ++count;
+        }
+        // "x = x" after replacing its source
+        if (i.is_copy() and i.arg1 == i.arg2) {
+          touched = true;
+          continue;
+        }
+        code.push_back(i);
+        operand d = i.def();
+        if (d.empty()) continue;
+        size_t v = df.var_index(d);
+        for (size_t a : active)
+          if (a == v or srcOf[a] == d) srcOf[a] = operand();
+        if (real_copy(i)) {
+          srcOf[v] = i.arg2;
+          active.push_back(v);
+        }
+      }
+      if (not touched) continue;
+      bb.instrs.swap(code);
+      df.update_block(b);
+    }
+    return count;
+  }
+
+}
+
+// propagate the copies of s; returns how many operands were replaced
+size_t CopyProp::run(subroutine &s) {
+  FlowGraph g(s);
+  DataFlow df(g);
+  size_t count = coalesce(g, df);
+  count += propagate(g, df);
+  if (count > 0) g.apply(s);
+  return count;
+}
@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////
+//
+//    CopyProp - Copy propagation on t-code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class CopyProp removes the copies made by the code generator
+// ("x = y", and "%t = x" from an unary plus):
+//
+//  - a computation whose result goes only to a copy writes the
+//    destination of the copy directly ("%t = a + b; x = %t" becomes
+//    "x = a + b")
+//  - after a copy "d = s", reads of d are replaced by s, while
+//    neither of them is redefined on any path (available copies)
+//
+// The copies left without readers are removed by DeadCode.
+//
+// An array param is never put as the base of an indexed access:
+// the VM needs its address in a temporal ("%t = a; %t[i]").
+
+class CopyProp {
+
+public:
+
+  // propagate the copies of s; returns how many operands were replaced
+  static std::size_t run(subroutine &s);
+};
@@ -0,0 +1,436 @@
+/////////////////////////////////////////////////////////////////
+//
+//    DataFlow - Liveness and def-use chains over a FlowGraph
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "DataFlow.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'bitSet'
+
+bitSet::bitSet(size_t n) : words((n + 63) / 64, 0), nbits(n) {}
+
+size_t bitSet::size() const { return nbits; }
+void bitSet::resize(size_t n) {
+  words.resize((n + 63) / 64, 0);
+  nbits = n;
+}
+bool bitSet::test(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+void bitSet::set(size_t i) { words[i / 64] |= uint64_t(1) << (i % 64); }
+void bitSet::reset(size_t i) { words[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+void bitSet::clear() { std::fill(words.begin(), words.end(), 0); }
+size_t bitSet::count() const {
+  size_t n = 0;
+  for (uint64_t w : words) n += __builtin_popcountll(w);
+  return n;
+}
+
+// this = this | o; returns true if this changed
+bool bitSet::unite(const bitSet &o) {
+  bool changed = false;
+  for (size_t w = 0; w < words.size(); ++w) {
+    uint64_t u = words[w] | o.words[w];
+    changed = changed or (u != words[w]);
+    words[w] = u;
+  }
+  return changed;
+}
+// this = this - o
+void bitSet::subtract(const bitSet &o) {
+  for (size_t w = 0; w < words.size(); ++w) words[w] &= ~o.words[w];
+}
+bool bitSet::operator==(const bitSet &o) const { return words == o.words; }
+bool bitSet::operator!=(const bitSet &o) const { return words != o.words; }
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'DataFlow'
+
+const DataFlow::site DataFlow::ENTRY = {UINT32_MAX, UINT32_MAX};
+
+namespace {
+  const size_t NONE = FlowGraph::NONE;
+  const std::vector<DataFlow::site> noSites;
+  // copies followed to find a constant
+  const int MAX_COPIES = 4;
+}
+
+DataFlow::DataFlow(const FlowGraph &g) : graph(g), resultVar(NONE), chainsValid(false) {
+  recompute();
+}
+
+uint32_t DataFlow::key(const operand &v) {
+  return (uint32_t(v.kind()) << operand::KIND_SHIFT) | v.id();
+}
+
+// variables
+size_t DataFlow::num_vars() const { return vars.size(); }
+const operand & DataFlow::var_at(size_t i) const { return vars[i]; }
+size_t DataFlow::var_index(const operand &v) const {
+  auto it = varIndex.find(key(v));
+  return it == varIndex.end() ? NONE : it->second;
+}
+
+// number the variables of block b not seen yet
+void DataFlow::add_vars_of_block(size_t b) {
+  static const uint32_t resultId = operand::intern("_result");
+  size_t before = vars.size();
+  for (const auto &i : graph.block(b).instrs) {
+    for (const operand *a : {&i.arg1, &i.arg2, &i.arg3}) {
+      if (not a->is_address()) continue;
+      if (varIndex.insert(make_pair(key(*a), uint32_t(vars.size()))).second) {
+        if (a->kind() == operand::_PARAM and a->id() == resultId) resultVar = vars.size();
+        vars.push_back(*a);
+      }
+    }
+  }
+  if (vars.size() != before) {
+    for (auto *sets : {&useSet, &defSet, &liveIn, &liveOut})
+      for (auto &bs : *sets) bs.resize(vars.size());
+  }
+}
+
+// upward-exposed uses and definitions of block b
+void DataFlow::compute_local(size_t b) {
+  bitSet &use = useSet[b], &def = defSet[b];
+  use.clear();
+  def.clear();
+  operand u[3];
+  for (const auto &i : graph.block(b).instrs) {
+    int n = i.uses(u);
+    for (int k = 0; k < n; ++k) {
+      size_t v = var_index(u[k]);
+      if (not def.test(v)) use.set(v);
+    }
+    operand d = i.def();
+    if (not d.empty()) def.set(var_index(d));
+  }
+}
+
+// iterate the liveness equations on the given blocks until nothing
+// changes (the other blocks keep their values)
+void DataFlow::solve(const std::vector<size_t> &blocks) {
+  vector<bool> pending(graph.num_blocks(), false);
+  vector<size_t> work;
+  // blocks are taken from the back: push them in reverse postorder,
+  // so that successors are usually processed first
+  vector<size_t> rank(graph.num_blocks(), NONE);
+  const auto &rpo = graph.reverse_postorder();
+  for (size_t i = 0; i < rpo.size(); ++i) rank[rpo[i]] = i;
+  vector<size_t> sorted(blocks);
+  stable_sort(sorted.begin(), sorted.end(),
+              [&rank](size_t a, size_t b) { return rank[a] < rank[b]; });
+  for (size_t b : sorted) {
+    work.push_back(b);
+    pending[b] = true;
+  }
+
+  while (not work.empty()) {
+    size_t b = work.back();
+    work.pop_back();
+    pending[b] = false;
+    const basicBlock &bb = graph.block(b);
+
+    bitSet out(vars.size());
+    for (size_t s : bb.succs) out.unite(liveIn[s]);
+    // '_result' is read by the caller when the subroutine returns
+    const instruction *last = bb.last();
+    if (bb.succs.empty() and resultVar != NONE and
+        not (last and last->oper == instruction::_HALT))
+      out.set(resultVar);
+    liveOut[b] = out;
+
+    out.subtract(defSet[b]);
+    out.unite(useSet[b]);
+    if (out != liveIn[b]) {
+      liveIn[b] = out;
+      for (size_t p : bb.preds)
+        if (not pending[p]) {
+          pending[p] = true;
+          work.push_back(p);
+        }
+    }
+  }
+}
+
+// the graph has changed: compute everything again
+void DataFlow::recompute() {
+  size_t nb = graph.num_blocks();
+  vars.clear();
+  varIndex.clear();
+  resultVar = NONE;
+  useSet.assign(nb, bitSet());
+  defSet.assign(nb, bitSet());
+  liveIn.assign(nb, bitSet());
+  liveOut.assign(nb, bitSet());
+  for (size_t b = 0; b < nb; ++b)
+    if (not graph.block(b).removed) add_vars_of_block(b);
+  for (auto *sets : {&useSet, &defSet, &liveIn, &liveOut})
+    for (auto &bs : *sets) bs.resize(vars.size());
+
+  vector<size_t> all;
+  for (size_t b = 0; b < nb; ++b) {
+    if (graph.block(b).removed) continue;
+    compute_local(b);
+    all.push_back(b);
+  }
+  solve(all);
+  chainsValid = false;
+}
+
+// the instructions of block b have changed (not the edges). Only
+// the blocks that reach b can change; they start again from empty
+// sets, so that liveness may also shrink.
+void DataFlow::update_block(size_t b) {
+  add_vars_of_block(b);
+  compute_local(b);
+  vector<size_t> affected;
+  vector<bool> seen(graph.num_blocks(), false);
+  affected.push_back(b);
+  seen[b] = true;
+  for (size_t i = 0; i < affected.size(); ++i)
+    for (size_t p : graph.block(affected[i]).preds)
+      if (not seen[p]) {
+        seen[p] = true;
+        affected.push_back(p);
+      }
+  for (size_t x : affected) liveIn[x].clear();
+  solve(affected);
+  chainsValid = false;
+}
+
+// liveness at the entry and exit of block b
+const bitSet & DataFlow::live_in(size_t b) const { return liveIn[b]; }
+const bitSet & DataFlow::live_out(size_t b) const { return liveOut[b]; }
+bool DataFlow::is_live_in(size_t b, const operand &v) const {
+  size_t i = var_index(v);
+  return i != NONE and liveIn[b].test(i);
+}
+bool DataFlow::is_live_out(size_t b, const operand &v) const {
+  size_t i = var_index(v);
+  return i != NONE and liveOut[b].test(i);
+}
+
+// live variables right after each instruction of block b
+void DataFlow::live_after(size_t b, std::vector<bitSet> &after) const {
+  const auto &instrs = graph.block(b).instrs;
+  after.assign(instrs.size(), bitSet());
+  bitSet live = liveOut[b];
+  operand u[3];
+  for (size_t k = instrs.size(); k-- > 0; ) {
+    after[k] = live;
+    operand d = instrs[k].def();
+    if (not d.empty()) live.reset(var_index(d));
+    int n = instrs[k].uses(u);
+    for (int j = 0; j < n; ++j) live.set(var_index(u[j]));
+  }
+}
+
+size_t DataFlow::instr_id(site s) const { return firstId[s.block] + s.index; }
+
+// use-def and def-use chains. Definitions that leave their block are
+// propagated with reaching definitions; only the last definition of
+// each live-out variable of a block takes part, so that the sets stay
+// small (most temporals never leave the block where they are defined).
+void DataFlow::compute_chains() {
+  size_t nb = graph.num_blocks();
+  firstId.assign(nb + 1, 0);
+  for (size_t b = 0; b < nb; ++b)
+    firstId[b+1] = firstId[b] + (graph.block(b).removed ? 0 : graph.block(b).instrs.size());
+  size_t ninstrs = firstId[nb];
+  useDefs.assign(3 * ninstrs, vector<site>());
+  defUses.assign(ninstrs, vector<site>());
+
+  // global definitions: the value of v at the entry (if it is live
+  // there), and the last definition of v in each block where it is
+  // live at the exit
+  vector<site> globalDefs;
+  vector<size_t> globalVar;
+  vector<vector<size_t>> defsOfVar(vars.size());
+  liveIn[0].for_each([&](size_t v) {
+      defsOfVar[v].push_back(globalDefs.size());
+      globalDefs.push_back(ENTRY);
+      globalVar.push_back(v);
+    });
+  vector<vector<size_t>> genOf(nb);
+  for (size_t b = 0; b < nb; ++b) {
+    if (graph.block(b).removed) continue;
+    const auto &instrs = graph.block(b).instrs;
+    vector<bool> done(vars.size(), false);
+    for (size_t k = instrs.size(); k-- > 0; ) {
+      operand d = instrs[k].def();
+      if (d.empty()) continue;
+      size_t v = var_index(d);
+      if (done[v] or not liveOut[b].test(v)) continue;
+      done[v] = true;
+      site s = {uint32_t(b), uint32_t(k)};
+      defsOfVar[v].push_back(globalDefs.size());
+      genOf[b].push_back(globalDefs.size());
+      globalDefs.push_back(s);
+      globalVar.push_back(v);
+    }
+  }
+
+  // reaching definitions (forward, union)
+  size_t nd = globalDefs.size();
+  vector<bitSet> in(nb, bitSet(nd)), out(nb, bitSet(nd)), gen(nb, bitSet(nd)), kill(nb, bitSet(nd));
+  for (size_t b = 0; b < nb; ++b) {
+    if (graph.block(b).removed) continue;
+    for (size_t d : genOf[b]) gen[b].set(d);
+    defSet[b].for_each([&](size_t v) {
+        for (size_t d : defsOfVar[v]) kill[b].set(d);
+      });
+    out[b] = gen[b];
+  }
+  for (size_t d = 0; d < nd; ++d)
+    if (globalDefs[d] == ENTRY) in[0].set(d);
+  const auto &rpo = graph.reverse_postorder();
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t b : rpo) {
+      for (size_t p : graph.block(b).preds) in[b].unite(out[p]);
+      bitSet o = in[b];
+      o.subtract(kill[b]);
+      o.unite(gen[b]);
+      if (o != out[b]) {
+        out[b] = o;
+        changed = true;
+      }
+    }
+  }
+
+  // walk every block linking each use with its definitions
+  for (size_t b = 0; b < nb; ++b) {
+    if (graph.block(b).removed) continue;
+    const auto &instrs = graph.block(b).instrs;
+    vector<size_t> localDef(vars.size(), NONE);
+    operand u[3];
+    for (size_t k = 0; k < instrs.size(); ++k) {
+      site here = {uint32_t(b), uint32_t(k)};
+      int n = instrs[k].uses(u);
+      for (int j = 0; j < n; ++j) {
+        size_t v = var_index(u[j]);
+        vector<site> &chain = useDefs[3 * instr_id(here) + j];
+        if (localDef[v] != NONE) chain.push_back({uint32_t(b), uint32_t(localDef[v])});
+        else
+          for (size_t d : defsOfVar[v])
+            if (in[b].test(d)) chain.push_back(globalDefs[d]);
+        for (const site &d : chain)
+          if (d != ENTRY) {
+            auto &uses = defUses[instr_id(d)];
+            if (uses.empty() or uses.back() != here) uses.push_back(here);
+          }
+      }
+      operand d = instrs[k].def();
+      if (not d.empty()) localDef[var_index(d)] = k;
+    }
+  }
+  chainsValid = true;
+}
+
+// definitions that may give its value to a use slot of the instruction at s
+const std::vector<DataFlow::site> & DataFlow::defs_of_use(site s, int slot) {
+  if (not chainsValid) compute_chains();
+  return useDefs[3 * instr_id(s) + slot];
+}
+
+// definitions that may reach the use of v by the instruction at s
+const std::vector<DataFlow::site> & DataFlow::reaching_defs(site s, const operand &v) {
+  operand u[3];
+  int n = graph.block(s.block).instrs[s.index].uses(u);
+  for (int j = 0; j < n; ++j)
+    if (u[j] == v) return defs_of_use(s, j);
+  return noSites;
+}
+
+// instructions that may read the value defined by the instruction at s
+const std::vector<DataFlow::site> & DataFlow::uses_of_def(site s) {
+  if (not chainsValid) compute_chains();
+  return defUses[instr_id(s)];
+}
+
+
+// integer constant held by v when the instruction at s reads it
+bool DataFlow::constant_at(site s, const operand &v, int64_t &value) {
+  return constant_at(s, v, value, 0);
+}
+bool DataFlow::constant_at(site s, const operand &v, int64_t &value, int depth) {
+  if (v.kind() == operand::_INT) {
+    value = stoll(v.to_string());
+    return true;
+  }
+  if (not v.is_address() or depth > MAX_COPIES) return false;
+  const vector<site> &defs = reaching_defs(s, v);
+  if (defs.size() != 1 or defs[0] == ENTRY) return false;
+  return defined_constant(defs[0], value, depth);
+}
+
+// integer constant written by the instruction at d
+bool DataFlow::defined_constant(site d, int64_t &value) {
+  return defined_constant(d, value, 0);
+}
+bool DataFlow::defined_constant(site d, int64_t &value, int depth) {
+  const instruction &i = graph.block(d.block).instrs[d.index];
+  if (i.oper == instruction::_ILOAD and i.arg2.kind() == operand::_INT) {
+    value = stoll(i.arg2.to_string());
+    return true;
+  }
+  if (i.oper == instruction::_LOAD and i.arg2.is_address())
+    return constant_at(d, i.arg2, value, depth + 1);
+  return false;
+}
+
+// true if the instruction at s adds a constant to v
+bool DataFlow::is_increment(site s, const operand &v, int64_t &step) {
+  if (adds_constant(s, v, step)) return true;
+  const auto &instrs = graph.block(s.block).instrs;
+  const instruction &i = instrs[s.index];
+  if (i.oper != instruction::_LOAD or not i.arg2.is_temp() or s.index == 0) return false;
+  site prev = {s.block, s.index - 1};
+  return instrs[prev.index].def() == i.arg2 and adds_constant(prev, v, step);
+}
+
+// "v = v + k", "v = k + v" or "v = v - k" at s, with k a constant
+bool DataFlow::adds_constant(site s, const operand &v, int64_t &step) {
+  const instruction &i = graph.block(s.block).instrs[s.index];
+  if (i.oper == instruction::_ADD and i.arg2 == v and i.arg3 != v)
+    return constant_at(s, i.arg3, step);
+  if (i.oper == instruction::_ADD and i.arg3 == v and i.arg2 != v)
+    return constant_at(s, i.arg2, step);
+  if (i.oper == instruction::_SUB and i.arg2 == v and i.arg3 != v and
+      constant_at(s, i.arg3, step)) {
+    step = -step;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,180 @@
+/////////////////////////////////////////////////////////////////
+//
+//    DataFlow - Liveness and def-use chains over a FlowGraph
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+#include "FlowGraph.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class bitSet: fixed size set of small integers, stored as words.
+
+class bitSet {
+public:
+  bitSet(std::size_t n = 0);
+
+  std::size_t size() const;
+  void resize(std::size_t n);
+  bool test(std::size_t i) const;
+  void set(std::size_t i);
+  void reset(std::size_t i);
+  void clear();
+  std::size_t count() const;
+
+  // this = this | o; returns true if this changed
+  bool unite(const bitSet &o);
+  // this = this - o
+  void subtract(const bitSet &o);
+  bool operator==(const bitSet &o) const;
+  bool operator!=(const bitSet &o) const;
+
+  // call f(i) for every i in the set, in increasing order
+  template <class F>
+  void for_each(F f) const {
+    for (std::size_t w = 0; w < words.size(); ++w) {
+      uint64_t bits = words[w];
+      while (bits) {
+        f(w * 64 + __builtin_ctzll(bits));
+        bits &= bits - 1;
+      }
+    }
+  }
+
+private:
+  std::vector<uint64_t> words;
+  std::size_t nbits;
+};
+
+
+////////////////////////////////////////////////////////////////
+// Class DataFlow computes, for the temporals, local vars and params
+// of a subroutine (see instruction::def and instruction::uses):
+//
+//  - liveness at the entry and exit of every block, and after every
+//    instruction (on demand, see live_after)
+//  - use-def and def-use chains
+//
+// '_result' is live when the subroutine returns. Stores to arrays are
+// memory writes, not definitions, so arrays are never killed.
+//
+// When a pass changes the instructions of a block, update_block()
+// recomputes only the blocks whose liveness may change; chains are
+// rebuilt lazily, on the next query. If the edges of the graph
+// change, call recompute().
+
+class DataFlow {
+
+public:
+
+  // position of an instruction: block and index in the block
+  struct site {
+    uint32_t block;
+    uint32_t index;
+    bool operator==(const site &o) const { return block == o.block and index == o.index; }
+    bool operator!=(const site &o) const { return not (*this == o); }
+    // key of the site in hash tables
+    uint64_t key() const { return (uint64_t(block) << 32) | index; }
+  };
+  // pseudo-definition giving the value a variable has on entry
+  static const site ENTRY;
+
+  DataFlow(const FlowGraph &g);
+
+  // variables (temporals, local vars and params) found in the code
+  std::size_t num_vars() const;
+  const operand & var_at(std::size_t i) const;
+  // index of the variable (FlowGraph::NONE if it does not appear)
+  std::size_t var_index(const operand &v) const;
+  // key of a variable in hash tables (its kind and id)
+  static uint32_t key(const operand &v);
+
+  // liveness at the entry and exit of block b
+  const bitSet & live_in(std::size_t b) const;
+  const bitSet & live_out(std::size_t b) const;
+  bool is_live_in(std::size_t b, const operand &v) const;
+  bool is_live_out(std::size_t b, const operand &v) const;
+  // live variables right after each instruction of block b
+  void live_after(std::size_t b, std::vector<bitSet> &after) const;
+
+  // definitions that may give its value to operand slot 'slot' (0..2,
+  // in the order of instruction::uses) of the instruction at s
+  const std::vector<site> & defs_of_use(site s, int slot);
+  // definitions that may reach the use of v by the instruction at s
+  const std::vector<site> & reaching_defs(site s, const operand &v);
+  // instructions that may read the value defined by the instruction at s
+  const std::vector<site> & uses_of_def(site s);
+
+  // integer constant held by v when the instruction at s reads it: v
+  // is a literal, or its only reaching definition writes a constant
+  // (false if it is not always the same one)
+  bool constant_at(site s, const operand &v, int64_t &value);
+  // integer constant written by the instruction at d: "x = k", or a
+  // copy "x = y" of a constant
+  bool defined_constant(site d, int64_t &value);
+  // true if the instruction at s adds a constant to v: "v = v + k",
+  // "v = k + v" or "v = v - k" (step is -k), also written as
+  // "%t = v + k; v = %t" (s is then the copy)
+  bool is_increment(site s, const operand &v, int64_t &step);
+
+  // the instructions of block b have changed (not the edges)
+  void update_block(std::size_t b);
+  // the graph has changed: compute everything again
+  void recompute();
+
+private:
+
+  const FlowGraph &graph;
+
+  std::vector<operand> vars;
+  std::unordered_map<uint32_t, uint32_t> varIndex;
+  std::size_t resultVar;    // index of '_result' (NONE if not used)
+
+  std::vector<bitSet> useSet, defSet, liveIn, liveOut;
+
+  bool chainsValid;
+  std::vector<std::size_t> firstId;               // first instruction id of each block
+  std::vector<std::vector<site>> useDefs;         // 3 per instruction id
+  std::vector<std::vector<site>> defUses;         // 1 per instruction id
+
+  bool constant_at(site s, const operand &v, int64_t &value, int depth);
+  bool defined_constant(site d, int64_t &value, int depth);
+  bool adds_constant(site s, const operand &v, int64_t &step);
+  void add_vars_of_block(std::size_t b);
+  void compute_local(std::size_t b);
+  void solve(const std::vector<std::size_t> &blocks);
+  void compute_chains();
+  std::size_t instr_id(site s) const;
+};
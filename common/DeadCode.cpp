@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////
+//
+//    DeadCode - Dead instruction elimination on t-code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "DeadCode.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'DeadCode'
+
+// remove the dead instructions of s; returns how many were removed
+size_t DeadCode::run(subroutine &s) {
+  FlowGraph g(s);
+  DataFlow df(g);
+  size_t removed = 0;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t b = 0; b < g.num_blocks(); ++b) {
+      basicBlock &bb = g.block(b);
+      if (bb.removed) continue;
+      // backwards, so that the operands of a removed instruction are
+      // not made live
+      bitSet live = df.live_out(b);
+      vector<bool> keep(bb.instrs.size(), true);
+      size_t dead = 0;
+      operand u[3];
+      for (size_t k = bb.instrs.size(); k-- > 0; ) {
+        const instruction &i = bb.instrs[k];
+        operand d = i.def();
+        if (not i.has_side_effects() and (d.empty() or not live.test(df.var_index(d)))) {
+          keep[k] = false;
+          ++dead;
+          continue;
+        }
+        if (not d.empty()) live.reset(df.var_index(d));
+        int n = i.uses(u);
+        for (int j = 0; j < n; ++j) live.set(df.var_index(u[j]));
+      }
+      if (dead == 0) continue;
+      arenaVector<instruction> code;
+      for (size_t k = 0; k < bb.instrs.size(); ++k)
+        if (keep[k]) code.push_back(bb.instrs[k]);
+      bb.instrs.swap(code);
+      // the blocks before may have lost readers of their results
+      df.update_block(b);
+      removed += dead;
+      changed = true;
+    }
+  }
+  if (removed > 0) g.apply(s);
+  return removed;
+}
@@ -0,0 +1,54 @@
+/////////////////////////////////////////////////////////////////
+//
+//    DeadFunctions - Removal of the subroutines never called
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+
+#include "DeadFunctions.h"
+#include "CallGraph.h"
+
+#include <vector>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'DeadFunctions'
+
+// remove the subroutines of c that main can not reach through calls;
+// returns how many were removed (none if c has no main)
+size_t DeadFunctions::run(code &c) {
+  CallGraph g(c);
+  if (g.entry() == CallGraph::NONE) return 0;
+  vector<bool> keep(g.num_subroutines());
+  size_t removed = 0;
+  for (size_t f = 0; f < g.num_subroutines(); ++f) {
+    keep[f] = g.reachable(f);
+    if (not keep[f]) ++removed;
+  }
+  if (removed > 0) c.remove_subroutines(keep);
+  return removed;
+}
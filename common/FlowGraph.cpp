@@ -0,0 +1,542 @@
+/////////////////////////////////////////////////////////////////
+//
+//    FlowGraph - Control flow graph of t-code subroutines
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "FlowGraph.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'basicBlock'
+
+basicBlock::basicBlock() : fallthrough(FlowGraph::NONE), removed(false) {}
+
+// label of the block (empty operand if it has none)
+operand basicBlock::label() const {
+  if (not instrs.empty() and instrs[0].oper == instruction::_LABEL) return instrs[0].arg1;
+  return operand();
+}
+
+// last instruction (nullptr if the block is empty)
+const instruction * basicBlock::last() const { return instrs.empty() ? nullptr : &instrs.back(); }
+instruction * basicBlock::last() { return instrs.empty() ? nullptr : &instrs.back(); }
+// true if the block may go on to its fallthrough
+bool basicBlock::falls_through() const { return instrs.empty() or not instrs.back().never_falls_through(); }
+
+
+////////////////////////////////////////////////////////////////
+// Auxiliary functions
+
+namespace {
+
+  const size_t NONE = FlowGraph::NONE;
+
+  // true if the instruction ends a basic block
+  bool ends_block(const instruction &i) {
+    return i.never_falls_through() or i.is_cond_jump();
+  }
+
+  void add_unique(vector<size_t> &v, size_t x) {
+    if (find(v.begin(), v.end(), x) == v.end()) v.push_back(x);
+  }
+
+  // dominators of a graph given as adjacency lists, with the algorithm
+  // of Cooper, Harvey and Kennedy ("A simple, fast dominance algorithm").
+  // Nodes not reachable from root get NONE everywhere.
+  struct domInfo {
+    vector<size_t> order;     // reverse postorder from root
+    vector<size_t> number;    // position in order
+    vector<size_t> idom;      // immediate dominator (root for root)
+    vector<size_t> in, out;   // preorder numbering of the dominator tree
+  };
+
+  void compute_dom(size_t root, const vector<vector<size_t>> &succ,
+                   const vector<vector<size_t>> &pred, domInfo &d) {
+    size_t n = succ.size();
+    d.order.clear();
+    d.number.assign(n, NONE);
+    d.idom.assign(n, NONE);
+    d.in.assign(n, NONE);
+    d.out.assign(n, NONE);
+    if (root >= n) return;
+
+    // iterative depth-first search to get the postorder
+    vector<bool> seen(n, false);
+    vector<pair<size_t, size_t>> stack;
+    stack.push_back(make_pair(root, 0));
+    seen[root] = true;
+    while (not stack.empty()) {
+      size_t x = stack.back().first;
+      size_t &next = stack.back().second;
+      if (next < succ[x].size()) {
+        size_t y = succ[x][next++];
+        if (not seen[y]) {
+          seen[y] = true;
+          stack.push_back(make_pair(y, 0));
+        }
+      }
+      else {
+        d.order.push_back(x);
+        stack.pop_back();
+      }
+    }
+    reverse(d.order.begin(), d.order.end());
+    for (size_t i = 0; i < d.order.size(); ++i) d.number[d.order[i]] = i;
+
+    auto intersect = [&d](size_t a, size_t b) {
+      while (a != b) {
+        while (d.number[a] > d.number[b]) a = d.idom[a];
+        while (d.number[b] > d.number[a]) b = d.idom[b];
+      }
+      return a;
+    };
+    d.idom[root] = root;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (size_t i = 1; i < d.order.size(); ++i) {
+        size_t x = d.order[i];
+        size_t newIdom = NONE;
+        for (size_t p : pred[x]) {
+          if (d.idom[p] == NONE) continue;
+          newIdom = (newIdom == NONE) ? p : intersect(p, newIdom);
+        }
+        if (newIdom != d.idom[x]) {
+          d.idom[x] = newIdom;
+          changed = true;
+        }
+      }
+    }
+
+    // number the dominator tree, so that dominance is an interval check
+    vector<vector<size_t>> children(n);
+    for (size_t x : d.order)
+      if (x != root) children[d.idom[x]].push_back(x);
+    size_t counter = 0;
+    stack.clear();
+    stack.push_back(make_pair(root, 0));
+    d.in[root] = counter++;
+    while (not stack.empty()) {
+      size_t x = stack.back().first;
+      size_t &next = stack.back().second;
+      if (next < children[x].size()) {
+        size_t y = children[x][next++];
+        d.in[y] = counter++;
+        stack.push_back(make_pair(y, 0));
+      }
+      else {
+        d.out[x] = counter++;
+        stack.pop_back();
+      }
+    }
+  }
+
+}
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'FlowGraph'
+
+const size_t FlowGraph::NONE;
+
+bool FlowGraph::loop::contains(size_t b) const {
+  return binary_search(blocks.begin(), blocks.end(), b);
+}
+
+// build the graph of the given subroutine
+FlowGraph::FlowGraph(const subroutine &s) : labelCount(0), maxTemp(0) {
+  build(s);
+  recompute_edges();
+}
+
+// split the instructions in blocks
+void FlowGraph::build(const subroutine &s) {
+  constSpan<instruction> code = s.get_instructions();
+  blocks.push_back(basicBlock());
+  for (size_t pc = 0; pc < code.size(); ++pc) {
+    const instruction &i = code[pc];
+    if (i.oper == instruction::_LABEL) {
+      if (not blocks.back().instrs.empty()) blocks.push_back(basicBlock());
+      usedLabels.push_back(i.arg1.id());
+    }
+    blocks.back().instrs.push_back(i);
+    for (const operand *a : {&i.arg1, &i.arg2, &i.arg3})
+      if (a->is_temp()) maxTemp = max(maxTemp, a->id());
+    if (ends_block(i) and pc+1 < code.size() and code[pc+1].oper != instruction::_LABEL)
+      blocks.push_back(basicBlock());
+  }
+  sort(usedLabels.begin(), usedLabels.end());
+
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    order.push_back(b);
+    if (b+1 < blocks.size() and blocks[b].falls_through())
+      blocks[b].fallthrough = b+1;
+  }
+}
+
+// number of blocks (including removed ones); also the virtual exit
+size_t FlowGraph::num_blocks() const { return blocks.size(); }
+size_t FlowGraph::exit_node() const { return blocks.size(); }
+// access to a block
+basicBlock & FlowGraph::block(size_t b) { return blocks[b]; }
+const basicBlock & FlowGraph::block(size_t b) const { return blocks[b]; }
+// order in which blocks are written by linearize
+std::vector<size_t> & FlowGraph::layout() { return order; }
+const std::vector<size_t> & FlowGraph::layout() const { return order; }
+
+// block that starts with the given label
+size_t FlowGraph::block_of_label(const operand &lab) const {
+  auto it = lower_bound(labelBlocks.begin(), labelBlocks.end(), make_pair(lab.id(), size_t(0)));
+  if (it == labelBlocks.end() or it->first != lab.id()) return NONE;
+  return it->second;
+}
+
+// block where the jump at the end of b goes
+size_t FlowGraph::jump_target(size_t b) const {
+  const instruction *l = blocks[b].last();
+  if (not l or not l->is_jump()) return NONE;
+  return block_of_label(l->jump_label());
+}
+
+// rebuild preds/succs and everything that depends on them
+void FlowGraph::recompute_edges() {
+  labelBlocks.clear();
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    if (blocks[b].removed) continue;
+    operand lab = blocks[b].label();
+    if (not lab.empty()) labelBlocks.push_back(make_pair(lab.id(), b));
+  }
+  sort(labelBlocks.begin(), labelBlocks.end());
+
+  for (auto &bb : blocks) {
+    bb.preds.clear();
+    bb.succs.clear();
+  }
+  for (size_t b = 0; b < blocks.size(); ++b) {
+    basicBlock &bb = blocks[b];
+    if (bb.removed) continue;
+    if (bb.falls_through() and bb.fallthrough != NONE and not blocks[bb.fallthrough].removed)
+      bb.succs.push_back(bb.fallthrough);
+    size_t t = jump_target(b);
+    if (t != NONE) add_unique(bb.succs, t);
+    for (size_t s : bb.succs) blocks[s].preds.push_back(b);
+  }
+
+  compute_dominators();
+  compute_post_dominators();
+  compute_loops();
+}
+
+void FlowGraph::compute_dominators() {
+  size_t n = blocks.size();
+  vector<vector<size_t>> succ(n), pred(n);
+  for (size_t b = 0; b < n; ++b) {
+    succ[b] = blocks[b].succs;
+    pred[b] = blocks[b].preds;
+  }
+  domInfo d;
+  compute_dom(0, succ, pred, d);
+  rpo.swap(d.order);
+  rpoNumber.swap(d.number);
+  idoms.swap(d.idom);
+  domIn.swap(d.in);
+  domOut.swap(d.out);
+}
+
+// post-dominators are the dominators of the reversed graph, rooted
+// at the virtual exit
+void FlowGraph::compute_post_dominators() {
+  size_t n = blocks.size();
+  vector<vector<size_t>> succ(n+1), pred(n+1);
+  for (size_t b = 0; b < n; ++b) {
+    if (blocks[b].removed) continue;
+    succ[b] = blocks[b].preds;
+    pred[b] = blocks[b].succs;
+    if (blocks[b].succs.empty()) {
+      succ[n].push_back(b);
+      pred[b].push_back(n);
+    }
+  }
+  domInfo d;
+  compute_dom(n, succ, pred, d);
+  ipdoms.swap(d.idom);
+  pdomIn.swap(d.in);
+  pdomOut.swap(d.out);
+}
+
+void FlowGraph::compute_loops() {
+  loopList.clear();
+  innermost.assign(blocks.size(), NONE);
+
+  // one loop per header, with the blocks of all its back edges
+  vector<size_t> loopOfHeader(blocks.size(), NONE);
+  for (size_t b : rpo) {
+    for (size_t h : blocks[b].succs) {
+      if (not dominates(h, b)) continue;
+      if (loopOfHeader[h] == NONE) {
+        loopOfHeader[h] = loopList.size();
+        loop l;
+        l.header = h;
+        l.blocks.push_back(h);
+        l.parent = NONE;
+        l.depth = 1;
+        loopList.push_back(l);
+      }
+      loop &l = loopList[loopOfHeader[h]];
+      l.latches.push_back(b);
+      // blocks that reach the latch without going through the header
+      vector<size_t> work;
+      if (find(l.blocks.begin(), l.blocks.end(), b) == l.blocks.end()) {
+        l.blocks.push_back(b);
+        work.push_back(b);
+      }
+      while (not work.empty()) {
+        size_t x = work.back();
+        work.pop_back();
+        for (size_t p : blocks[x].preds) {
+          if (not reachable(p)) continue;
+          if (find(l.blocks.begin(), l.blocks.end(), p) == l.blocks.end()) {
+            l.blocks.push_back(p);
+            work.push_back(p);
+          }
+        }
+      }
+    }
+  }
+  for (auto &l : loopList) sort(l.blocks.begin(), l.blocks.end());
+
+  // outer loops first; natural loops with different headers are
+  // either disjoint or nested, so the parent is the smallest loop
+  // seen so far that contains the header
+  stable_sort(loopList.begin(), loopList.end(),
+              [](const loop &a, const loop &b) { return a.blocks.size() > b.blocks.size(); });
+  for (size_t i = 0; i < loopList.size(); ++i) {
+    loop &l = loopList[i];
+    for (size_t j = i; j-- > 0; ) {
+      if (loopList[j].contains(l.header)) {
+        l.parent = j;
+        l.depth = loopList[j].depth + 1;
+        break;
+      }
+    }
+    for (size_t b : l.blocks) innermost[b] = i;
+  }
+}
+
+// blocks reachable from the entry in reverse postorder
+const std::vector<size_t> & FlowGraph::reverse_postorder() const { return rpo; }
+bool FlowGraph::reachable(size_t b) const { return b < rpoNumber.size() and rpoNumber[b] != NONE; }
+
+// immediate dominator of b
+size_t FlowGraph::idom(size_t b) const {
+  if (b == 0 or not reachable(b)) return NONE;
+  return idoms[b];
+}
+// true if every path from the entry to b goes through a
+bool FlowGraph::dominates(size_t a, size_t b) const {
+  if (not reachable(a) or not reachable(b)) return false;
+  return domIn[a] <= domIn[b] and domOut[b] <= domOut[a];
+}
+// immediate post-dominator of b
+size_t FlowGraph::ipdom(size_t b) const {
+  if (b >= blocks.size() or ipdoms[b] == NONE) return NONE;
+  return ipdoms[b];
+}
+// true if every path from b to the exit goes through a
+bool FlowGraph::post_dominates(size_t a, size_t b) const {
+  if (a > blocks.size() or b > blocks.size() or pdomIn[a] == NONE or pdomIn[b] == NONE) return false;
+  return pdomIn[a] <= pdomIn[b] and pdomOut[b] <= pdomOut[a];
+}
+
+// natural loops, outer loops before the loops they contain
+const std::vector<FlowGraph::loop> & FlowGraph::loops() const { return loopList; }
+// innermost loop containing b
+size_t FlowGraph::loop_of(size_t b) const { return b < innermost.size() ? innermost[b] : NONE; }
+// blocks out of the loop that are successors of some block in it
+std::vector<size_t> FlowGraph::loop_exits(const loop &l) const {
+  vector<size_t> exits;
+  for (size_t b : l.blocks)
+    for (size_t s : blocks[b].succs)
+      if (not l.contains(s)) add_unique(exits, s);
+  return exits;
+}
+// innermost loop with header h
+size_t FlowGraph::loop_with_header(size_t h) const {
+  for (size_t k = loopList.size(); k-- > 0; )
+    if (loopList[k].header == h) return k;
+  return NONE;
+}
+// headers of the loops, inner loops first
+std::vector<size_t> FlowGraph::headers_innermost_first() const {
+  vector<size_t> headers;
+  for (size_t k = loopList.size(); k-- > 0; ) headers.push_back(loopList[k].header);
+  return headers;
+}
+
+// block that runs right before loop l is entered from outside
+size_t FlowGraph::preheader(const loop &l) {
+  size_t h = l.header;
+  if (h == 0) {
+    // the entry cannot move: the code of the header goes to a new
+    // block laid out after it, and the entry is left empty
+    size_t nh = add_block();
+    order.pop_back();
+    order.insert(find(order.begin(), order.end(), size_t(0)) + 1, nh);
+    blocks[nh].instrs.swap(blocks[0].instrs);
+    blocks[nh].fallthrough = blocks[0].fallthrough;
+    for (auto &bb : blocks)
+      if (bb.fallthrough == 0) bb.fallthrough = nh;
+    blocks[0].fallthrough = nh;
+    recompute_edges();
+    return 0;
+  }
+  vector<size_t> outside;
+  for (size_t p : blocks[h].preds)
+    if (not l.contains(p)) outside.push_back(p);
+  // a single block that can only go to the header
+  if (outside.size() == 1 and blocks[outside[0]].succs.size() == 1 and
+      (not blocks[outside[0]].last() or not ends_block(*blocks[outside[0]].last())))
+    return outside[0];
+
+  size_t ph = add_block();
+  order.pop_back();
+  order.insert(find(order.begin(), order.end(), h), ph);
+  blocks[ph].fallthrough = h;
+  for (size_t p : outside) {
+    basicBlock &bb = blocks[p];
+    if (bb.fallthrough == h) bb.fallthrough = ph;
+    if (jump_target(p) == h) {
+      bb.last()->jump_label() = ensure_label(ph);
+    }
+  }
+  recompute_edges();
+  return ph;
+}
+
+// preheader of loops()[li], keeping li up to date
+size_t FlowGraph::preheader_of(size_t &li, bool &added) {
+  size_t nb = blocks.size();
+  // a copy: the loops are computed again if blocks are added
+  loop l = loopList[li];
+  size_t ph = preheader(l);
+  added = blocks.size() != nb;
+  if (added) li = loop_with_header(blocks[ph].succs[0]);
+  return ph;
+}
+
+// add an empty block at the end of the layout
+size_t FlowGraph::add_block() {
+  blocks.push_back(basicBlock());
+  order.push_back(blocks.size()-1);
+  return blocks.size()-1;
+}
+
+// make sure block b starts with a label
+operand FlowGraph::ensure_label(size_t b) {
+  operand lab = blocks[b].label();
+  if (not lab.empty()) return lab;
+  lab = new_label();
+  blocks[b].instrs.insert(blocks[b].instrs.begin(), instruction(instruction::_LABEL, lab));
+  auto pos = make_pair(lab.id(), b);
+  labelBlocks.insert(lower_bound(labelBlocks.begin(), labelBlocks.end(), pos), pos);
+  return lab;
+}
+
+// fresh label, not used anywhere in the subroutine
+operand FlowGraph::new_label() {
+  while (true) {
+    operand lab(operand::_LABEL, "bb" + std::to_string(++labelCount));
+    auto it = lower_bound(usedLabels.begin(), usedLabels.end(), lab.id());
+    if (it != usedLabels.end() and *it == lab.id()) continue;
+    usedLabels.insert(it, lab.id());
+    return lab;
+  }
+}
+
+// fresh temporal, not used anywhere in the subroutine
+operand FlowGraph::new_temp() { return operand::make(operand::_TEMP, ++maxTemp); }
+
+// rebuild the sequence of instructions, in layout order
+instructionList FlowGraph::linearize() {
+  vector<size_t> live;
+  for (size_t b : order)
+    if (not blocks[b].removed) live.push_back(b);
+
+  // a block that falls through to a block not laid out after it
+  // needs an explicit goto, and its successor needs a label
+  vector<size_t> gotoTarget(live.size(), NONE);
+  for (size_t i = 0; i < live.size(); ++i) {
+    const basicBlock &bb = blocks[live[i]];
+    size_t next = (i+1 < live.size()) ? live[i+1] : NONE;
+    if (bb.falls_through() and bb.fallthrough != NONE and
+        not blocks[bb.fallthrough].removed and bb.fallthrough != next) {
+      gotoTarget[i] = bb.fallthrough;
+      ensure_label(bb.fallthrough);
+    }
+  }
+
+  instructionList code;
+  for (size_t i = 0; i < live.size(); ++i) {
+    for (const auto &inst : blocks[live[i]].instrs) code = code || inst;
+    if (gotoTarget[i] != NONE)
+      code = code || instruction(instruction::_UJUMP, blocks[gotoTarget[i]].label());
+  }
+  return code;
+}
+
+// store the rebuilt instructions in the subroutine
+void FlowGraph::apply(subroutine &s) { s.set_instructions(linearize()); }
+
+// print blocks, edges, dominators and loops (for debugging)
+std::string FlowGraph::dump() const {
+  auto num = [](size_t x) { return x == NONE ? string("-") : std::to_string(x); };
+  auto list = [&num](const vector<size_t> &v) {
+    string s;
+    for (size_t x : v) s += " " + num(x);
+    return s;
+  };
+  string s;
+  for (size_t b : order) {
+    const basicBlock &bb = blocks[b];
+    if (bb.removed) continue;
+    s += "BB" + std::to_string(b) + "  preds:" + list(bb.preds) + "  succs:" + list(bb.succs) +
+         "  idom: " + num(idom(b)) + "  ipdom: " + num(ipdom(b));
+    if (loop_of(b) != NONE) s += "  loop: " + num(loop_of(b));
+    s += "\n";
+    for (const auto &i : bb.instrs) s += "  " + i.dump() + "\n";
+  }
+  for (size_t i = 0; i < loopList.size(); ++i) {
+    const loop &l = loopList[i];
+    s += "loop " + std::to_string(i) + "  header: BB" + std::to_string(l.header) +
+         "  depth: " + std::to_string(l.depth) + "  parent: " + num(l.parent) +
+         "  blocks:" + list(l.blocks) + "  latches:" + list(l.latches) + "\n";
+  }
+  return s;
+}
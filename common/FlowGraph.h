@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////////////
+//
+//    FlowGraph - Control flow graph of t-code subroutines
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class basicBlock: a maximal sequence of instructions that is
+// entered only at its first one and left only after its last one.
+// A block starts with a label or after a jump, return or halt.
+
+class basicBlock {
+public:
+  basicBlock();
+
+  // instructions of the block (the label, if any, is the first one)
+  arenaVector<instruction> instrs;
+  // blocks that may be executed right before/after this one
+  std::vector<std::size_t> preds, succs;
+  // block that follows this one when its last instruction does not
+  // jump (FlowGraph::NONE after a goto, return or halt). It is kept
+  // even if blocks are laid out in another order.
+  std::size_t fallthrough;
+  // removed blocks are kept (block numbers do not change) but are
+  // ignored everywhere
+  bool removed;
+
+  // label of the block (empty operand if it has none)
+  operand label() const;
+  // last instruction (nullptr if the block is empty)
+  const instruction * last() const;
+  instruction * last();
+  // true if the block may go on to its fallthrough: it is empty, or
+  // its last instruction is not a goto, return or halt
+  bool falls_through() const;
+};
+
+
+////////////////////////////////////////////////////////////////
+// Class FlowGraph splits a subroutine in basic blocks and computes
+// the relations needed by the optimizations: predecessors and
+// successors, dominators, post-dominators and natural loops.
+//
+// Passes may edit the instructions of the blocks, add blocks, remove
+// them or change the layout. After that, recompute_edges() brings the
+// graph up to date, and linearize() rebuilds an instructionList
+// (adding the gotos needed when a fallthrough block is not laid out
+// next).
+//
+// Block 0 is the entry. Blocks that leave the subroutine (return,
+// halt, or the last block if it falls off the end) go to a virtual
+// exit node, numbered num_blocks().
+
+class FlowGraph {
+
+public:
+
+  static const std::size_t NONE = std::size_t(-1);
+
+  // a natural loop: the header and all blocks that can reach one of
+  // its back edges without going through the header
+  struct loop {
+    std::size_t header;
+    std::vector<std::size_t> blocks;    // sorted, includes the header
+    std::vector<std::size_t> latches;   // sources of the back edges
+    std::size_t parent;                 // innermost enclosing loop (or NONE)
+    unsigned depth;                     // 1 for outermost loops
+    bool contains(std::size_t b) const;
+  };
+
+  // build the graph of the given subroutine
+  FlowGraph(const subroutine &s);
+
+  // number of blocks (including removed ones); also the virtual exit
+  std::size_t num_blocks() const;
+  std::size_t exit_node() const;
+  // access to a block
+  basicBlock & block(std::size_t b);
+  const basicBlock & block(std::size_t b) const;
+  // order in which blocks are written by linearize
+  std::vector<std::size_t> & layout();
+  const std::vector<std::size_t> & layout() const;
+
+  // block that starts with the given label (NONE if there is none)
+  std::size_t block_of_label(const operand &lab) const;
+  // block where the jump at the end of b goes (NONE if b does not end in a jump)
+  std::size_t jump_target(std::size_t b) const;
+
+  // rebuild preds/succs from the instructions and fallthroughs, and
+  // recompute dominators, post-dominators and loops
+  void recompute_edges();
+
+  // blocks reachable from the entry in reverse postorder
+  const std::vector<std::size_t> & reverse_postorder() const;
+  bool reachable(std::size_t b) const;
+
+  // immediate dominator of b (NONE for the entry and unreachable blocks)
+  std::size_t idom(std::size_t b) const;
+  // true if every path from the entry to b goes through a
+  bool dominates(std::size_t a, std::size_t b) const;
+  // immediate post-dominator of b (exit_node() if it is the exit, NONE
+  // if b never reaches the exit)
+  std::size_t ipdom(std::size_t b) const;
+  // true if every path from b to the exit goes through a
+  bool post_dominates(std::size_t a, std::size_t b) const;
+
+  // natural loops, outer loops before the loops they contain
+  const std::vector<loop> & loops() const;
+  // innermost loop containing b (NONE if b is not in a loop)
+  std::size_t loop_of(std::size_t b) const;
+  // blocks out of the loop that are successors of some block in it
+  std::vector<std::size_t> loop_exits(const loop &l) const;
+  // index in loops() of the innermost loop with header h (NONE if h
+  // is not the header of a loop)
+  std::size_t loop_with_header(std::size_t h) const;
+  // headers of the loops, inner loops before the loops that contain
+  // them. Passes that add blocks while they go through the loops
+  // (see preheader) look each one up again with loop_with_header
+  std::vector<std::size_t> headers_innermost_first() const;
+
+  // block that runs right before loop l is entered from outside.
+  // If no block can play that role, one is added (laid out before the
+  // header; if the header is the entry, its code moves to a new block
+  // instead) and the edges are recomputed, so references to loops and
+  // their blocks are no longer valid
+  std::size_t preheader(const loop &l);
+  // preheader of loops()[li]. 'added' tells if blocks were added: then
+  // the edges are recomputed, and li is the index of the same loop in
+  // the new graph (found by the header, that may have moved)
+  std::size_t preheader_of(std::size_t &li, bool &added);
+
+  // add an empty block at the end of the layout, and return its number
+  std::size_t add_block();
+  // make sure block b starts with a label, and return it
+  operand ensure_label(std::size_t b);
+  // fresh label and temporal, not used anywhere in the subroutine
+  operand new_label();
+  operand new_temp();
+
+  // rebuild the sequence of instructions
+  instructionList linearize();
+  // store the rebuilt instructions in the subroutine
+  void apply(subroutine &s);
+
+  // print blocks, edges, dominators and loops (for debugging)
+  std::string dump() const;
+
+private:
+
+  std::vector<basicBlock> blocks;
+  std::vector<std::size_t> order;
+  // interned id of a label -> block
+  std::vector<std::pair<uint32_t, std::size_t>> labelBlocks;
+
+  std::vector<std::size_t> rpo;
+  std::vector<std::size_t> rpoNumber;       // NONE if unreachable
+  std::vector<std::size_t> idoms;
+  std::vector<std::size_t> domIn, domOut;   // dominator tree numbering
+  std::vector<std::size_t> ipdoms;          // size num_blocks()+1 (exit last)
+  std::vector<std::size_t> pdomIn, pdomOut;
+  std::vector<loop> loopList;
+  std::vector<std::size_t> innermost;
+
+  std::vector<uint32_t> usedLabels;
+  uint32_t labelCount;
+  uint32_t maxTemp;
+
+  void build(const subroutine &s);
+  void compute_dominators();
+  void compute_post_dominators();
+  void compute_loops();
+};
@@ -0,0 +1,225 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Inliner - Inlining of small subroutines at their call sites
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "Inliner.h"
+
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'Inliner'
+
+namespace {
+
+  const string RESULT = "_result";
+
+  // instructions of the body of s that a copy adds to a caller
+  long body_size(const subroutine &s) {
+    constSpan<instruction> code = s.get_instructions();
+    long n = 0;
+    for (const instruction &i : code)
+      if (i.oper != instruction::_LABEL) ++n;
+    if (not code.empty() and code.back().oper == instruction::_RETURN) --n;
+    return n;
+  }
+
+  class inliner {
+  public:
+    inliner(code &c, size_t threshold) : c(c), threshold(threshold), count(0) {
+      constSpan<subroutine> subrs = c.get_subroutine_list();
+      for (size_t k = 0; k < subrs.size(); ++k) index[subrs[k].get_name()] = k;
+      state.assign(subrs.size(), NEW);
+    }
+
+    size_t run() {
+      for (size_t k = 0; k < state.size(); ++k)
+        if (state[k] == NEW) visit(k);
+      return count;
+    }
+
+  private:
+    enum { NEW, ACTIVE, DONE };
+    code &c;
+    long threshold;
+    size_t count;
+    map<string, size_t> index;
+    vector<int> state;
+
+    // subroutine called by a call instruction (NONE if unknown)
+    size_t callee(const instruction &i) const {
+      auto it = index.find(i.arg1.to_string());
+      return it == index.end() ? size_t(-1) : it->second;
+    }
+
+    // inline into f once its callees are done. The callees still
+    // active call f back, and are left as calls
+    void visit(size_t f) {
+      state[f] = ACTIVE;
+      for (const instruction &i : c.get_subroutine_at(f).get_instructions()) {
+        if (i.oper != instruction::_CALL) continue;
+        size_t g = callee(i);
+        if (g != size_t(-1) and state[g] == NEW) visit(g);
+      }
+      inline_calls(c.get_subroutine_at(f));
+      state[f] = DONE;
+    }
+
+    void inline_calls(subroutine &s);
+  };
+
+  // inline the calls of s to the callees that are done and small
+  void inliner::inline_calls(subroutine &s) {
+    vector<instruction> code(s.get_instructions().begin(), s.get_instructions().end());
+    size_t n = code.size();
+    // what replaces each instruction of a call site that is inlined
+    vector<bool> replaced(n, false);
+    vector<vector<instruction>> with(n);
+    uint32_t nextTemp = s.max_temp();
+    size_t inlined = 0;
+
+    for (size_t pc = 0; pc < n; ++pc) {
+      if (code[pc].oper != instruction::_CALL) continue;
+      size_t g = callee(code[pc]);
+      if (g == size_t(-1) or state[g] != DONE) continue;
+      const subroutine &f = c.get_subroutine_list()[g];
+      const vector<var> params(f.params.begin(), f.params.end());
+      size_t np = params.size();
+      bool hasResult = np > 0 and params[0].name == RESULT;
+
+      // the pushes of this call, skipping those of the calls made
+      // while computing the arguments, and then its pops
+      vector<size_t> push(np);
+      size_t depth = 0, found = 0;
+      for (size_t k = pc; k-- > 0 and found < np; ) {
+        if (code[k].oper == instruction::_POP) ++depth;
+        else if (code[k].oper == instruction::_PUSH) {
+          if (depth > 0) --depth;
+          else push[np - ++found] = k;
+        }
+      }
+      if (found < np) continue;
+      bool ok = true;
+      for (size_t k = 1; k <= np; ++k)
+        ok = ok and pc + k < n and code[pc+k].oper == instruction::_POP and
+             (code[pc+k].arg1.empty() or (hasResult and k == np));
+      if (not ok) continue;
+      long scalars = 0;
+      for (size_t k = 0; k < np; ++k) {
+        if (hasResult and k == 0) continue;
+        if (not params[k].is_array()) ++scalars;
+        // the address pushed for an array must not change until the call
+        else if (code[push[k]].arg1.is_address())
+          for (size_t j = push[k] + 1; j < pc; ++j)
+            ok = ok and code[j].def() != code[push[k]].arg1;
+      }
+      long growth = body_size(f) + scalars + hasResult - long(2 * np + 1);
+      if (not ok or growth > threshold) continue;
+
+      // names of the copy
+      string prefix = "_i" + to_string(++inlined) + "_";
+      map<uint32_t, operand> arrays;      // array param -> pushed address
+      for (size_t k = 0; k < np; ++k) {
+        const instruction &p = code[push[k]];
+        replaced[push[k]] = true;
+        if (hasResult and k == 0) {
+          s.add_var(prefix + params[k].name, params[k].type);
+          continue;
+        }
+        if (params[k].is_array()) arrays[operand::intern(params[k].name)] = p.arg1;
+        else {
+          s.add_var(prefix + params[k].name, params[k].type);
+          with[push[k]].push_back(instruction(instruction::_LOAD,
+                                              operand(operand::_VAR, prefix + params[k].name), p.arg1));
+        }
+      }
+      for (const var &v : f.vars) s.add_var(prefix + v.name, v.type, v.nelem);
+      uint32_t base = nextTemp;
+      nextTemp += f.max_temp();
+      auto rename = [&](const operand &o) -> operand {
+        switch (o.kind()) {
+        case operand::_TEMP:
+          return operand::make(operand::_TEMP, base + o.id());
+        case operand::_PARAM: {
+          auto it = arrays.find(o.id());
+          if (it != arrays.end()) return it->second;
+          return operand(operand::_VAR, prefix + o.to_string());
+        }
+        case operand::_VAR:
+          return operand(operand::_VAR, prefix + o.to_string());
+        case operand::_LABEL:
+          return operand(operand::_LABEL, prefix + o.to_string());
+        default:
+          return o;
+        }
+      };
+
+      // the body, with its returns going to the end of the copy
+      vector<instruction> &body = with[pc];
+      replaced[pc] = true;
+      constSpan<instruction> calleeCode = f.get_instructions();
+      operand end(operand::_LABEL, prefix + "end");
+      bool jumpsToEnd = false;
+      for (size_t k = 0; k < calleeCode.size(); ++k) {
+        const instruction &i = calleeCode[k];
+        if (i.oper == instruction::_RETURN) {
+          if (k + 1 == calleeCode.size()) continue;
+          body.push_back(instruction(instruction::_UJUMP, end));
+          jumpsToEnd = true;
+          continue;
+        }
+        body.push_back(instruction(i.oper, rename(i.arg1), rename(i.arg2), rename(i.arg3)));
+      }
+      if (jumpsToEnd) body.push_back(instruction(instruction::_LABEL, end));
+      for (size_t k = 1; k <= np; ++k) replaced[pc+k] = true;
+      if (hasResult and not code[pc+np].arg1.empty())
+        with[pc+np].push_back(instruction(instruction::_LOAD, code[pc+np].arg1,
+                                          operand(operand::_VAR, prefix + RESULT)));
+    }
+    if (inlined == 0) return;
+
+    instructionList result;
+    for (size_t pc = 0; pc < n; ++pc) {
+      if (not replaced[pc]) result = result || code[pc];
+      else for (const instruction &i : with[pc]) result = result || i;
+    }
+    s.set_instructions(result);
+    count += inlined;
+  }
+
+}
+
+// inline the small callees of every subroutine of c; returns how
+// many calls were inlined
+size_t Inliner::run(code &c, size_t threshold) {
+  return inliner(c, threshold).run();
+}
@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////////
+//
+//    Inliner - Inlining of small subroutines at their call sites
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class Inliner replaces the calls to small subroutines by a copy of
+// their body. A call
+//
+//    pushparam             (room for the result)
+//    pushparam a           (one per argument)
+//    call f
+//    popparam              (one per argument)
+//    popparam %r
+//
+// becomes "_iN_x = a" at the push of each param x passed by value,
+// the body of f, and "%r = _iN__result" at the last pop. In the
+// copy, the local vars, params and labels of f get the prefix _iN_
+// (N counts the inlined calls of the caller; ASL names never start
+// with '_'), its temporals are renumbered after those of the caller,
+// and its returns jump to the end of the copy. An array param is
+// replaced by the address that was pushed for it.
+//
+// A call is inlined if the caller grows by at most 'threshold'
+// instructions: the size of the body (without labels and its last
+// return), plus the copies of the params and the result, minus the
+// pushes, pops and call that go away. Callees are inlined before
+// their callers, so a caller sees the body of its callees once their
+// own calls have been inlined. Recursive calls are never inlined.
+
+class Inliner {
+
+public:
+
+  // inline the small callees of every subroutine of c; returns how
+  // many calls were inlined
+  static std::size_t run(code &c, std::size_t threshold);
+};
@@ -83,6 +83,7 @@ const std::string LLVMCodeGen::LLVM_FPEXT       = "fpext";
 const std::string LLVMCodeGen::LLVM_TRUNC       = "trunc";
 const std::string LLVMCodeGen::LLVM_FPTRUNC     = "fptrunc";
 const std::string LLVMCodeGen::LLVM_SEXT        = "sext";
+const std::string LLVMCodeGen::LLVM_BITCAST     = "bitcast";
 
 
 const std::map<instruction::Operation, std::string> LLVMCodeGen::tcode2llvmInstrMap = {
@@ -100,6 +101,14 @@ const std::map<instruction::Operation, std::string> LLVMCodeGen::tcode2llvmInstr
   { instruction::_FEQ,  "fcmp oeq" },
   { instruction::_FLT,  "fcmp olt" },
   { instruction::_FLE,  "fcmp ole" },
+  { instruction::_FJLT,  "icmp slt" },
+  { instruction::_FJLE,  "icmp sle" },
+  { instruction::_FJEQ,  "icmp eq" },
+  { instruction::_FJNE,  "icmp ne" },
+  { instruction::_FJFLT, "fcmp olt" },
+  { instruction::_FJFLE, "fcmp ole" },
+  { instruction::_FJFEQ, "fcmp oeq" },
+  { instruction::_FJFNE, "fcmp une" },
   { instruction::_AND,  "and" },
   { instruction::_OR,   "or" },
 };
@@ -109,7 +118,7 @@ LLVMCodeGen::LLVMCodeGen(const TypesMgr & Types, const SymTable & Symbols, const
   : Types{Types}, Symbols{Symbols}, tCode{tCode},
     writeI(false), writeF(false), writeC(false), writeLN(false),
     readI(false), readF(false), readC(false),
-    haltAndExit(false),
+    haltAndExit(false), blockCopy(false),
     globalI(false), globalF(false), globalC(false)
 {
   std::string failFunc, failTempVar;
@@ -132,17 +141,26 @@ void LLVMCodeGen::check_SSA_tCode(std::string & failFunc, std::string & failTemp
   failFunc = "";
   failTempVar = "";
   for (auto & subr: tCode.get_subroutine_list()) {
-    std::map<std::string, int> modTempCounts;
+    std::map<operand, int> modTempCounts;
     for (auto & instr: subr.get_instructions()) {
       switch (instr.oper) {
       case instruction::_LABEL:
       case instruction::_UJUMP:
       case instruction::_FJUMP:
+      case instruction::_FJLT:
+      case instruction::_FJLE:
+      case instruction::_FJEQ:
+      case instruction::_FJNE:
+      case instruction::_FJFLT:
+      case instruction::_FJFLE:
+      case instruction::_FJFEQ:
+      case instruction::_FJFNE:
       case instruction::_HALT:
       case instruction::_PUSH:
       case instruction::_RETURN:
       case instruction::_XLOAD:
       case instruction::_CLOAD:
+      case instruction::_BCOPY:
       case instruction::_WRITEI:
       case instruction::_WRITEF:
       case instruction::_WRITEC:
@@ -153,9 +171,8 @@ void LLVMCodeGen::check_SSA_tCode(std::string & failFunc, std::string & failTemp
         break;
       default:                 // Except in instruction::_POP, where is optional (arg1 may be ""),
                                // the argument arg1 always does exist.
-        std::string arg1 = getTCodeArg(instr, 1);
-        if (isTCodeTemporal(arg1)) {
-          modTempCounts[arg1] += 1;
+        if (instr.arg1.is_temp()) {
+          modTempCounts[instr.arg1] += 1;
         }
         break;
       }
@@ -163,7 +180,7 @@ void LLVMCodeGen::check_SSA_tCode(std::string & failFunc, std::string & failTemp
     for (auto & pair : modTempCounts) {
       if (pair.second > 1) {
         failFunc = subr.get_name();
-        failTempVar = pair.first;
+        failTempVar = pair.first.to_string();
         return;
       }
     }
@@ -190,9 +207,6 @@ bool LLVMCodeGen::isTCodeIdentifier(const std::string & tcodeArg) const {
 void LLVMCodeGen::computeReadWriteHaltInfo() {
   for (auto & subr: tCode.get_subroutine_list()) {
     for (auto & instr: subr.get_instructions()) {
-      std::string arg1 = getTCodeArg(instr, 1);
-      std::string arg2 = getTCodeArg(instr, 2);
-      std::string arg3 = getTCodeArg(instr, 3);
       switch (instr.oper) {
       case instruction::_WRITEI:
         writeI = true;
@@ -204,8 +218,8 @@ void LLVMCodeGen::computeReadWriteHaltInfo() {
         writeC = true;
         break;
       case instruction::_WRITES:
-        if (std::find(writeSAslStrVec.begin(), writeSAslStrVec.end(), arg1) == writeSAslStrVec.end()) {
-          writeSAslStrVec.push_back(arg1);
+        if (std::find(writeSAslStrVec.begin(), writeSAslStrVec.end(), instr.arg1.to_string()) == writeSAslStrVec.end()) {
+          writeSAslStrVec.push_back(instr.arg1.to_string());
         }
         writeS = true;
         break;
@@ -214,22 +228,25 @@ void LLVMCodeGen::computeReadWriteHaltInfo() {
         break;
       case instruction::_READI:
         readI = true;
-        if (isTCodeTemporal(arg1))
+        if (instr.arg1.is_temp())
           globalI = true;
         break;
       case instruction::_READF:
         readF = true;
-        if (isTCodeTemporal(arg1))
+        if (instr.arg1.is_temp())
           globalF = true;
         break;
       case instruction::_READC:
         readC = true;
-        if (isTCodeTemporal(arg1))
+        if (instr.arg1.is_temp())
           globalC = true;
         break;
       case instruction::_HALT:
 	haltAndExit = true;
 	break;
+      case instruction::_BCOPY:
+        blockCopy = true;
+        break;
       default:
         break;
       }
@@ -247,8 +264,8 @@ void LLVMCodeGen::bindTCodeLocalSymbolsToLLVMTypes(const subroutine & subr) {
   llvmLocalValueVec.clear();
   llvmLocalValueTypeMap.clear();
   llvmLocalValueCountMap.clear();
-  std::string funcName = subr.get_name();
-  for (auto param : subr.params) {
+  const std::string & funcName = subr.get_name();
+  for (const auto & param : subr.params) {
     std::string llvmType;
     if (param.name == "_result")
       llvmType = getFuncReturnLLVMType(funcName);
@@ -256,11 +273,11 @@ void LLVMCodeGen::bindTCodeLocalSymbolsToLLVMTypes(const subroutine & subr) {
       llvmType = getLocalSymbolLLVMType(funcName, param.name, true);
     bindTCodeLocalValueWithType(param.name, llvmType);
   }
-  for (auto varlocal : subr.vars) {
+  for (const auto & varlocal : subr.vars) {
     std::string llvmType = getLocalSymbolLLVMType(funcName, varlocal.name);
     bindTCodeLocalValueWithType(varlocal.name, llvmType);
   }
-  for (auto instr : subr.get_instructions()) {
+  for (const auto & instr : subr.get_instructions()) {
     std::string arg1 = getTCodeArg(instr, 1);
     std::string arg2 = getTCodeArg(instr, 2);
     std::string arg3 = getTCodeArg(instr, 3);
@@ -281,6 +298,37 @@ void LLVMCodeGen::bindTCodeLocalSymbolsToLLVMTypes(const subroutine & subr) {
         bindTCodeLocalValueWithType(arg2, LLVM_LABEL);
         break;
       }
+    case instruction::_FJLT:
+    case instruction::_FJLE:
+    case instruction::_FJEQ:
+    case instruction::_FJNE:
+      {
+        if (isTCodeIdentifier(arg1) and isTCodeTemporal(arg2)) {
+          std::string llvmValue1 = getLLVMValue(arg1);
+          std::string llvmType1 = getLLVMTypeOfValue(llvmValue1);
+          bindTCodeLocalValueWithType(arg2, llvmType1);
+        }
+        else if (isTCodeTemporal(arg1) and isTCodeIdentifier(arg2)) {
+          std::string llvmValue2 = getLLVMValue(arg2);
+          std::string llvmType2 = getLLVMTypeOfValue(llvmValue2);
+          bindTCodeLocalValueWithType(arg1, llvmType2);
+        }
+        else if (isTCodeTemporal(arg1) and isTCodeTemporal(arg2)) {
+          bindPairOfTCodeLocalValuesWithTypes(arg1, arg2);
+        }
+        bindTCodeLocalValueWithType(arg3, LLVM_LABEL);
+        break;
+      }
+    case instruction::_FJFLT:
+    case instruction::_FJFLE:
+    case instruction::_FJFEQ:
+    case instruction::_FJFNE:
+      {
+        bindTCodeLocalValueWithType(arg1, LLVM_FLOAT);
+        bindTCodeLocalValueWithType(arg2, LLVM_FLOAT);
+        bindTCodeLocalValueWithType(arg3, LLVM_LABEL);
+        break;
+      }
     case instruction::_HALT:
       {
         break;
@@ -690,7 +738,10 @@ void LLVMCodeGen::generateReadWriteHaltBeginEndCode(std::string & begin, std::st
   if (haltAndExit) {
     end += "declare dso_local void @exit(i32) noreturn nounwind\n";
   }
-  if (writeI or writeF or writeC or writeS or writeLN or readI or readF or readC or haltAndExit)
+  if (blockCopy) {
+    end += "declare void @llvm.memcpy.p0i8.p0i8.i64(i8* nocapture writeonly, i8* nocapture readonly, i64, i1 immarg)\n";
+  }
+  if (writeI or writeF or writeC or writeS or writeLN or readI or readF or readC or haltAndExit or blockCopy)
     end += "\n";
 }
 
@@ -729,14 +780,14 @@ std::string LLVMCodeGen::dumpSubroutine(const subroutine & subr) {
 std::string LLVMCodeGen::dumpHeader(const subroutine & subr) {
   std::string llvmCode;
   llvmCode += "define dso_local ";
-  std::string funcName = subr.get_name();
+  const std::string & funcName = subr.get_name();
   if (funcName == "main") {
     llvmCode += LLVM_INT + " @" + "main" + "() ";
   }
   else {
     llvmCode += getFuncReturnLLVMType(funcName) + " @" + funcName + "(";
     bool firstParam = true;
-    for (auto p : subr.params) {
+    for (const auto & p : subr.params) {
       if (p.name != "_result") {
         std::string llvmValue = getLLVMValue(p.name);
         std::string llvmType  = getLocalSymbolLLVMType(funcName, p.name, true);
@@ -752,8 +803,8 @@ std::string LLVMCodeGen::dumpHeader(const subroutine & subr) {
 
 std::string LLVMCodeGen::dumpAllocaParams(const subroutine & subr) {
   std::string llvmCode;
-  std::string funcName = subr.get_name();
-  for (auto p : subr.params) {
+  const std::string & funcName = subr.get_name();
+  for (const auto & p : subr.params) {
     std::string llvmValue = getLLVMValue(p.name);
     std::string llvmType;
     if (p.name == "_result")
@@ -771,8 +822,8 @@ std::string LLVMCodeGen::dumpAllocaParams(const subroutine & subr) {
 
 std::string LLVMCodeGen::dumpAllocaLocalVars(const subroutine & subr) {
   std::string llvmCode;
-  std::string funcName = subr.get_name();
-  for (auto v : subr.vars) {
+  const std::string & funcName = subr.get_name();
+  for (const auto & v : subr.vars) {
     std::string llvmValue     = getLLVMValue(v.name);
     std::string llvmType      = getLocalSymbolLLVMType(funcName, v.name);
     std::string llvmValueAddr = getLLVMValueAddr(llvmValue);
@@ -786,7 +837,7 @@ std::string LLVMCodeGen::dumpAllocaLocalVars(const subroutine & subr) {
 
 std::string LLVMCodeGen::dumpStoreParams(const subroutine & subr) {
   std::string llvmCode;
-  std::string funcName = subr.get_name();
+  const std::string & funcName = subr.get_name();
   if (funcName == "main") {
     // std::string llvmValue     = getLLVMValue("_result");
     // // std::string llvmType      = LLVM_INT;
@@ -799,7 +850,7 @@ std::string LLVMCodeGen::dumpStoreParams(const subroutine & subr) {
   if (subr.params.size() > 0) {
     llvmCode += llvmComment("params initialization:");
   }
-  for (auto p : subr.params) {
+  for (const auto & p : subr.params) {
     if (p.name != "_result") {
       std::string llvmValue     = getLLVMValue(p.name);
       std::string llvmValueAddr = getLLVMValueAddr(llvmValue);
@@ -811,8 +862,9 @@ std::string LLVMCodeGen::dumpStoreParams(const subroutine & subr) {
 
 std::string LLVMCodeGen::dumpInstructionList(const subroutine & subr) {
   std::string llvmCode;
-  int n = subr.get_instructions().size();
-  instructionList instrList = subr.get_instructions();
+  constSpan<instruction> instrList = subr.get_instructions();
+  int n = instrList.size();
+  if (n == 0) return llvmCode;
   for (int i = 0; i < n-1; ++i) {
     llvmCode += llvmComment(instrList[i].dump());
     llvmCode += dumpInstruction(instrList[i], instrList[i+1]);
@@ -868,11 +920,50 @@ std::string LLVMCodeGen::dumpInstruction(const instruction & instr,
         llvmCode += createLABEL(labelContName);
       }
       else {
-        std::string labelCont = getLLVMValue(next.arg1);
+        std::string labelCont = getLLVMValue(next.arg1.to_string());
         llvmCode += createBR(llvmValue1, labelCont, labelJump);
       }
       break;
     }
+  case instruction::_FJLT:
+  case instruction::_FJLE:
+  case instruction::_FJEQ:
+  case instruction::_FJNE:
+  case instruction::_FJFLT:
+  case instruction::_FJFLE:
+  case instruction::_FJFEQ:
+  case instruction::_FJFNE:
+    {
+      // the comparison goes to a fresh i1 value, used only by the br
+      accessValueOfArgument(tcodeArg1, llvmValue1, llvmMemCodeValue1);
+      accessValueOfArgument(tcodeArg2, llvmValue2, llvmMemCodeValue2);
+      bool negated;
+      instruction::Operation rel = instruction::branch_relation(instr.oper, negated);
+      std::string llvmType12 = LLVM_FLOAT;
+      if (rel == instruction::_LT or rel == instruction::_LE or rel == instruction::_EQ) {
+        llvmType12 = LLVM_INT;
+        if (isTCodeIdentifier(tcodeArg1) or isTCodeTemporal(tcodeArg1))
+          llvmType12 = getLLVMTypeOfValue(getLLVMValue(tcodeArg1));
+        else if (isTCodeIdentifier(tcodeArg2) or isTCodeTemporal(tcodeArg2))
+          llvmType12 = getLLVMTypeOfValue(getLLVMValue(tcodeArg2));
+      }
+      llvmCode += llvmMemCodeValue1;
+      llvmCode += llvmMemCodeValue2;
+      std::string llvmCond = createNewPrefixedValueWithType("%.cmp", LLVM_BOOL);
+      llvmCode += createCOMPARISON(instr.oper, llvmCond, llvmValue1, llvmValue2, llvmType12);
+      std::string labelJump = getLLVMValue(tcodeArg3);
+      if (next.oper != instruction::_LABEL and next.oper != instruction::_NOOP) {
+        std::string labelCont = createNewPrefixedValueWithType("%.br.cont", LLVM_LABEL);
+        std::string labelContName = labelCont.substr(1);
+        llvmCode += createBR(llvmCond, labelCont, labelJump);
+        llvmCode += createLABEL(labelContName);
+      }
+      else {
+        std::string labelCont = getLLVMValue(next.arg1.to_string());
+        llvmCode += createBR(llvmCond, labelCont, labelJump);
+      }
+      break;
+    }
   case instruction::_HALT:
     {
       llvmCode += createHALT();
@@ -1068,6 +1159,37 @@ std::string LLVMCodeGen::dumpInstruction(const instruction & instr,
         llvmCode += createLOAD(llvmValue1, llvmValue2Addr);
       break;
     }
+  case instruction::_BCOPY:
+    {
+      // i8* to the first element of each array, and the size in bytes
+      std::string llvmBytePtr[2];
+      std::size_t elemBytes = 1;
+      const std::string *tcodeArrays[2] = { &tcodeArg1, &tcodeArg2 };
+      for (int k = 0; k < 2; ++k) {
+        std::string llvmValue = getLLVMValue(*tcodeArrays[k]);
+        std::string llvmType = getLLVMTypeOfValue(llvmValue);   // it can  be "array of" or "pointer to"
+        std::string llvmElemType;
+        if (isLLVMArrayType(llvmType))
+          llvmElemType = getLLVMElementOfArrayType(llvmType);
+        else if (isPointerType(llvmType))
+          llvmElemType = getPointedType(llvmType);
+        std::string llvmElemTypePtr = getPointerToType(llvmElemType);
+        std::string arrayPointer = createNewPrefixedValueWithType("%.arrPtr", llvmElemTypePtr);
+        std::string llvmValueAddr;
+        if (isTCodeIdentifier(*tcodeArrays[k]))
+          llvmValueAddr = getLLVMValueAddr(llvmValue);
+        else
+          llvmValueAddr = llvmValue;
+        llvmCode += createGETELEMENTPTR(arrayPointer, llvmValueAddr, LLVM_ZERO_INT);
+        llvmBytePtr[k] = createNewPrefixedValueWithType("%.bytePtr", LLVM_CHAR_PTR);
+        llvmCode += createCONVERSION(LLVM_BITCAST, llvmBytePtr[k], arrayPointer, llvmElemTypePtr);
+        if (llvmElemType == LLVM_INT or llvmElemType == LLVM_FLOAT)
+          elemBytes = 4;
+      }
+      llvmCode += createMEMCPY(llvmBytePtr[0], llvmBytePtr[1],
+                               std::stoul(tcodeArg3) * elemBytes);
+      break;
+    }
     /*
   case instruction::_LOADC:
     {
@@ -1313,8 +1435,7 @@ std::string LLVMCodeGen::dumpInstruction(const instruction & instr,
     }
   }
 
-  prevInstrIsTerminator = (instr.oper == instruction::_UJUMP or
-                           instr.oper == instruction::_FJUMP or
+  prevInstrIsTerminator = (instr.is_jump() or
                            instr.oper == instruction::_RETURN);
   
   return llvmCode;
@@ -1324,11 +1445,11 @@ std::string LLVMCodeGen::dumpInstruction(const instruction & instr,
 std::string LLVMCodeGen::getTCodeArg(const instruction & instr, int i) const {
   std::string arg;
   if (i == 1)
-    arg = instr.arg1;
+    arg = instr.arg1.to_string();
   else if (i == 2)
-    arg = instr.arg2;
+    arg = instr.arg2.to_string();
   else     // i == 3
-    arg = instr.arg3;
+    arg = instr.arg3.to_string();
   return arg;
 }
 
@@ -1473,6 +1594,13 @@ std::string LLVMCodeGen::createHALT() const {
   return llvmCode;
 }
 
+std::string LLVMCodeGen::createMEMCPY(const std::string & llvmDestPtr, const std::string & llvmSrcPtr,
+                                      std::size_t bytes) const {
+  std::string llvmCode;
+  llvmCode += INDENT_INSTR + "call void @llvm.memcpy.p0i8.p0i8.i64(i8* " + llvmDestPtr + ", i8* " + llvmSrcPtr + ", i64 " + std::to_string(bytes) + ", i1 false)\n";
+  return llvmCode;
+}
+
 std::string LLVMCodeGen::createBR(const std::string & llvmValue) const {
   std::string llvmCode;
   llvmCode += INDENT_INSTR + "br label " + llvmValue + "\n";
@@ -82,11 +82,13 @@ class LLVMCodeGen {
   static const std::string LLVM_TRUNC;
   static const std::string LLVM_FPTRUNC;
   static const std::string LLVM_SEXT;
+  static const std::string LLVM_BITCAST;
   static const std::map<instruction::Operation, std::string> tcode2llvmInstrMap;
 
   bool writeI, writeF, writeC, writeS, writeLN;
   bool readI, readF, readC;
   bool haltAndExit;
+  bool blockCopy;
   bool globalI, globalF, globalC, globalS;
   std::vector<std::string>            writeSAslStrVec;
   std::vector<std::string::size_type> writeSLLVMStrSizeVec;
@@ -159,6 +161,8 @@ class LLVMCodeGen {
   std::string createPUTCHAR(const std::string & llvmValue) const;
   std::string createSCANF(const std::string & llvmValueAddr) const;
   std::string createHALT() const;
+  std::string createMEMCPY(const std::string & llvmDestPtr, const std::string & llvmSrcPtr,
+                           std::size_t bytes) const;
   std::string createBR(const std::string & llvmValue) const;
   std::string createBR(const std::string & llvmValue,
                        const std::string & labelCont, const std::string & labelJump) const;
@@ -0,0 +1,227 @@
+/////////////////////////////////////////////////////////////////
+//
+//    LoopInvariant - Loop-invariant code motion
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "LoopInvariant.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <string>
+#include <unordered_set>
+#include <cstdint>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'LoopInvariant'
+
+namespace {
+
+  typedef DataFlow::site site;
+
+  // memory that a base address may point to: a local array, the
+  // arrays given as parameters, or anything
+  struct region {
+    enum { LOCAL, PARAM, ANY } kind;
+    operand array;
+  };
+
+  bool overlap(const region &a, const region &b) {
+    if (a.kind == region::ANY or b.kind == region::ANY) return true;
+    if (a.kind != b.kind) return false;
+    return a.kind == region::PARAM or a.array == b.array;
+  }
+
+  // region of the base address 'base', read by the instruction at s
+  region region_of(DataFlow &df, const FlowGraph &g, site s, const operand &base) {
+    if (base.kind() == operand::_VAR) return region{region::LOCAL, base};
+    if (base.kind() == operand::_PARAM) return region{region::PARAM, operand()};
+    // a temporal holding "&a" or an array parameter
+    region r{region::ANY, operand()};
+    bool first = true;
+    for (const site &d : df.reaching_defs(s, base)) {
+      if (d == DataFlow::ENTRY) return region{region::ANY, operand()};
+      const instruction &i = g.block(d.block).instrs[d.index];
+      region ri{region::ANY, operand()};
+      if (i.oper == instruction::_ALOAD and i.arg2.kind() == operand::_VAR)
+        ri = region{region::LOCAL, i.arg2};
+      else if (i.oper == instruction::_LOAD and i.arg2.kind() == operand::_PARAM)
+        ri = region{region::PARAM, operand()};
+      if (first) r = ri;
+      else if (ri.kind != r.kind or ri.array != r.array) return region{region::ANY, operand()};
+      first = false;
+    }
+    return r;
+  }
+
+  // true if the divisor of the DIV at s is always a constant that
+  // is not zero
+  bool safe_division(DataFlow &df, site s, const operand &v) {
+    int64_t value;
+    return df.constant_at(s, v, value) and value != 0;
+  }
+
+  // true if block b runs whenever the preheader of l does: every way
+  // out of l, and every back edge, goes through b. Otherwise a read
+  // of memory moved out of b may run when the original did not (the
+  // loop runs zero times, or b is behind a test of the index)
+  bool always_runs(const FlowGraph &g, const FlowGraph::loop &l, size_t b) {
+    bool exits = false;
+    for (size_t x : l.blocks)
+      for (size_t y : g.block(x).succs)
+        if (not l.contains(y)) {
+          exits = true;
+          if (not g.dominates(b, x)) return false;
+        }
+    for (size_t x : l.latches)
+      if (not g.dominates(b, x)) return false;
+    // a loop that is never left may not get to b
+    return exits;
+  }
+
+  // instructions of l that can be moved to its preheader, in an
+  // order where every one comes after those it depends on
+  vector<site> invariants(const FlowGraph &g, DataFlow &df, const FlowGraph::loop &l) {
+    vector<site> found;
+    // temporals defined more than once in the loop, and memory that
+    // the loop may write
+    unordered_set<uint32_t> seen, redefined;
+    vector<region> stores;
+    bool calls = false;
+    for (size_t b : l.blocks) {
+      const basicBlock &bb = g.block(b);
+      for (size_t k = 0; k < bb.instrs.size(); ++k) {
+        const instruction &i = bb.instrs[k];
+        operand d = i.def();
+        if (not d.empty() and not seen.insert(DataFlow::key(d)).second)
+          redefined.insert(DataFlow::key(d));
+        site s{uint32_t(b), uint32_t(k)};
+        if (i.oper == instruction::_XLOAD or i.oper == instruction::_BCOPY)
+          stores.push_back(region_of(df, g, s, i.arg1));
+        else if (i.oper == instruction::_CLOAD) stores.push_back(region{region::ANY, operand()});
+        else if (i.oper == instruction::_CALL) calls = true;
+      }
+    }
+
+    unordered_set<uint64_t> moved;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (size_t b : g.reverse_postorder()) {
+        if (not l.contains(b)) continue;
+        const basicBlock &bb = g.block(b);
+        for (size_t k = 0; k < bb.instrs.size(); ++k) {
+          const instruction &i = bb.instrs[k];
+          site s{uint32_t(b), uint32_t(k)};
+          if (moved.count(s.key())) continue;
+          operand d = i.def();
+          if (not d.is_temp() or redefined.count(DataFlow::key(d)) or
+              df.is_live_in(l.header, d))
+            continue;
+          if (i.oper == instruction::_DIV) {
+            if (not safe_division(df, s, i.arg3)) continue;
+          }
+          else if (i.has_side_effects())
+            continue;
+          if (i.oper == instruction::_LOADX or i.oper == instruction::_LOADC) {
+            if (calls or not always_runs(g, l, b)) continue;
+            region r = i.oper == instruction::_LOADX ? region_of(df, g, s, i.arg2)
+                                                    : region{region::ANY, operand()};
+            bool clobbered = false;
+            for (const region &w : stores) clobbered = clobbered or overlap(r, w);
+            if (clobbered) continue;
+          }
+          // every operand comes from out of the loop, or from an
+          // instruction that is moved
+          operand u[3];
+          int n = i.uses(u);
+          bool invariant = true;
+          for (int j = 0; j < n and invariant; ++j) {
+            const vector<site> &defs = df.defs_of_use(s, j);
+            for (const site &ds : defs)
+              if (ds != DataFlow::ENTRY and l.contains(ds.block) and
+                  not (defs.size() == 1 and moved.count(ds.key())))
+                invariant = false;
+          }
+          if (not invariant) continue;
+          moved.insert(s.key());
+          found.push_back(s);
+          changed = true;
+        }
+      }
+    }
+    return found;
+  }
+
+}
+
+// move the invariant instructions of the loops of s; returns how
+// many instructions were moved
+size_t LoopInvariant::run(subroutine &s) {
+  FlowGraph g(s);
+  if (g.loops().empty()) return 0;
+  DataFlow df(g);
+
+  size_t count = 0;
+  for (size_t h : g.headers_innermost_first()) {
+    size_t li = g.loop_with_header(h);
+    if (li == FlowGraph::NONE) continue;
+    vector<site> found = invariants(g, df, g.loops()[li]);
+    if (found.empty()) continue;
+
+    bool added;
+    size_t ph = g.preheader_of(li, added);
+    if (added) {
+      df.recompute();
+      found = invariants(g, df, g.loops()[li]);
+    }
+
+    vector<size_t> touched;
+    vector<vector<bool>> keep(g.num_blocks());
+    for (const site &x : found) {
+      if (keep[x.block].empty()) {
+        keep[x.block].assign(g.block(x.block).instrs.size(), true);
+        touched.push_back(x.block);
+      }
+      keep[x.block][x.index] = false;
+      g.block(ph).instrs.push_back(g.block(x.block).instrs[x.index]);
+      ++count;
+    }
+    for (size_t b : touched) {
+      arenaVector<instruction> code;
+      basicBlock &bb = g.block(b);
+      for (size_t k = 0; k < bb.instrs.size(); ++k)
+        if (keep[b][k]) code.push_back(bb.instrs[k]);
+      bb.instrs.swap(code);
+    }
+    df.recompute();
+  }
+  if (count > 0) g.apply(s);
+  return count;
+}
@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////////////////
+//
+//    LoopInvariant - Loop-invariant code motion
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class LoopInvariant moves out of natural loops the instructions
+// that compute the same value in every iteration, to the preheader
+// of the loop (see FlowGraph::preheader).
+//
+// An instruction is moved when it has no side effects, it defines
+// a temporal that has no other definition in the loop and is not
+// live at the header, and every operand is defined only out of the
+// loop or by an instruction that is moved too. Integer divisions
+// (that may trap) are moved only when they divide by a constant
+// other than zero.
+//
+// Reads of memory (a[i], *p) are moved only when no store or call in
+// the loop may write what they read. Different local arrays never
+// overlap, and a local array never overlaps an array parameter;
+// anything else may. As a read out of bounds crashes, they must also
+// run whenever the loop is entered: their block has to dominate every
+// exit and latch of the loop. So reads in the body of a while loop
+// stay where they are (the loop may run zero times) unless the loop
+// was rotated, and so do reads behind an index check or an if.
+//
+// Inner loops are processed before the loops that contain them, so
+// an instruction may end up out of several loops.
+
+class LoopInvariant {
+
+public:
+
+  // move the invariant instructions of the loops of s; returns how
+  // many instructions were moved
+  static std::size_t run(subroutine &s);
+};
@@ -0,0 +1,297 @@
+/////////////////////////////////////////////////////////////////
+//
+//    LoopUnroll - Unrolling of loops with a constant trip count
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "LoopUnroll.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <cstdint>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'LoopUnroll'
+
+namespace {
+
+  typedef DataFlow::site site;
+
+  const size_t NONE = FlowGraph::NONE;
+
+  // iterations followed at most to find the trip count
+  const int64_t MAX_TRIP = 1 << 20;
+
+  // the only definition of v in l, if it adds a constant to v (also
+  // as "%t = v + k; v = %t")
+  bool increment_of(DataFlow &df, const FlowGraph &g, const FlowGraph::loop &l,
+                    const operand &v, site &update, int64_t &step) {
+    unsigned defs = 0;
+    for (size_t b : l.blocks) {
+      const basicBlock &bb = g.block(b);
+      for (size_t k = 0; k < bb.instrs.size(); ++k)
+        if (bb.instrs[k].def() == v) {
+          ++defs;
+          update = site{uint32_t(b), uint32_t(k)};
+        }
+    }
+    return defs == 1 and df.is_increment(update, v, step);
+  }
+
+  // a loop that can be unrolled
+  struct counted {
+    size_t header;
+    int64_t trip;
+    size_t size;    // instructions of the loop (without labels)
+  };
+
+  // true if l is a counted loop (see LoopUnroll.h) that runs at
+  // least once, and then its trip count and size
+  bool analyze(const FlowGraph &g, DataFlow &df, const FlowGraph::loop &l, counted &c) {
+    const basicBlock &h = g.block(l.header);
+    if (l.latches.size() != 1 or h.label().empty()) return false;
+    for (const FlowGraph::loop &o : g.loops())
+      if (o.header != l.header and l.contains(o.header)) return false;
+
+    // the only way out is the jump that ends the header
+    const instruction *last = h.last();
+    if (not last->is_cond_jump()) return false;
+    size_t exitBlock = g.jump_target(l.header);
+    if (exitBlock == NONE or l.contains(exitBlock) or
+        h.fallthrough == NONE or not l.contains(h.fallthrough))
+      return false;
+    size_t size = 0;
+    for (size_t b : l.blocks) {
+      for (size_t s : g.block(b).succs)
+        if (not l.contains(s) and (b != l.header or s != exitBlock)) return false;
+      for (const instruction &i : g.block(b).instrs)
+        if (i.oper != instruction::_LABEL) ++size;
+    }
+
+    // the test: "a < b" or "a <= b"
+    size_t n = h.instrs.size();
+    bool negated;
+    instruction::Operation rel = instruction::branch_relation(last->oper, negated);
+    operand a, b;
+    site at;
+    if (rel != instruction::_INVALID) {
+      if (negated) return false;
+      a = last->arg1;
+      b = last->arg2;
+      at = site{uint32_t(l.header), uint32_t(n - 1)};
+    }
+    else {
+      size_t k = n - 1;
+      while (k > 0 and h.instrs[k-1].def() != last->arg1) --k;
+      if (k == 0) return false;
+      const instruction &cmp = h.instrs[k-1];
+      rel = cmp.oper;
+      a = cmp.arg2;
+      b = cmp.arg3;
+      at = site{uint32_t(l.header), uint32_t(k - 1)};
+    }
+    if (rel != instruction::_LT and rel != instruction::_LE) return false;
+
+    // one side is the induction variable, the other a constant
+    for (int side = 0; side < 2; ++side) {
+      const operand &v = side == 0 ? a : b;
+      const operand &bound = side == 0 ? b : a;
+      site update;
+      int64_t step, limit, init;
+      if (not v.is_address() or not increment_of(df, g, l, v, update, step)) continue;
+      if (update.block == l.header or not g.dominates(update.block, l.latches[0])) continue;
+      if (not df.constant_at(at, bound, limit)) continue;
+      // the value on entry comes from a single definition out of the loop
+      vector<site> defs = df.reaching_defs(at, v);
+      vector<site> outside;
+      bool ok = true;
+      for (const site &d : defs) {
+        if (d == update) continue;
+        if (d == DataFlow::ENTRY or l.contains(d.block)) ok = false;
+        else outside.push_back(d);
+      }
+      if (not ok or outside.size() != 1 or not df.defined_constant(outside[0], init)) continue;
+
+      int64_t trip = 0;
+      for (int64_t i = init; ; i += step) {
+        int64_t lhs = side == 0 ? i : limit, rhs = side == 0 ? limit : i;
+        if (not (rel == instruction::_LT ? lhs < rhs : lhs <= rhs)) break;
+        if (++trip > MAX_TRIP or i + step < INT32_MIN or i + step > INT32_MAX) return false;
+      }
+      if (trip == 0) return false;
+      c = counted{l.header, trip, size};
+      return true;
+    }
+    return false;
+  }
+
+  // writes the copies of a loop in place of its header
+  class unroller {
+  public:
+    unroller(FlowGraph &g, const FlowGraph::loop &l) : g(g), l(l) {
+      order.push_back(l.header);
+      for (size_t b : g.layout())
+        if (b != l.header and l.contains(b) and not g.block(b).removed) order.push_back(b);
+    }
+
+    // the copies of all the iterations, and the header once more,
+    // that falls through to the exit
+    void full(int64_t trip) {
+      vector<operand> starts = labels(trip + 1);
+      for (int64_t t = 0; t < trip; ++t) copy(false, starts[t], starts[t+1]);
+      out.push_back(instruction(instruction::_LABEL, starts[trip]));
+      const basicBlock &h = g.block(l.header);
+      for (size_t j = 0; j + 1 < h.instrs.size(); ++j)
+        if (h.instrs[j].oper != instruction::_LABEL) out.push_back(h.instrs[j]);
+      finish(g.jump_target(l.header));
+    }
+
+    // 'rest' copies before a loop of 'factor' copies, tested at the
+    // first one
+    void partial(size_t factor, size_t rest) {
+      vector<operand> starts = labels(rest + factor);
+      for (size_t t = 0; t < rest + factor; ++t) {
+        operand next = t + 1 == rest + factor ? starts[rest] : starts[t+1];
+        copy(t == rest, starts[t], next);
+      }
+      finish(NONE);
+    }
+
+  private:
+    FlowGraph &g;
+    const FlowGraph::loop &l;
+    // blocks in the order they are copied, the header first
+    vector<size_t> order;
+    vector<instruction> out;
+    // ids of the labels added
+    set<uint32_t> added;
+
+    operand new_label() {
+      operand lab = g.new_label();
+      added.insert(lab.id());
+      return lab;
+    }
+
+    // labels of the copies: the first one keeps the header's
+    vector<operand> labels(size_t n) {
+      vector<operand> v(1, g.block(l.header).label());
+      while (v.size() < n) v.push_back(new_label());
+      return v;
+    }
+
+    // a copy of the loop, starting at 'start', where the jumps to the
+    // header go to 'next'. The exit test is kept if 'test' is set
+    void copy(bool test, const operand &start, const operand &next) {
+      map<size_t, operand> labelOf;
+      auto target = [&](size_t b) {
+        if (b == l.header) return next;
+        auto it = labelOf.find(b);
+        if (it == labelOf.end()) it = labelOf.insert(make_pair(b, new_label())).first;
+        return it->second;
+      };
+      out.push_back(instruction(instruction::_LABEL, start));
+      for (size_t k = 0; k < order.size(); ++k) {
+        size_t b = order[k];
+        const basicBlock &bb = g.block(b);
+        if (b != l.header) out.push_back(instruction(instruction::_LABEL, target(b)));
+        for (size_t j = 0; j < bb.instrs.size(); ++j) {
+          instruction i = bb.instrs[j];
+          if (i.oper == instruction::_LABEL) continue;
+          if (b == l.header and j + 1 == bb.instrs.size()) {
+            if (test) out.push_back(i);
+            continue;
+          }
+          if (i.is_jump()) i.jump_label() = target(g.block_of_label(i.jump_label()));
+          out.push_back(i);
+        }
+        if (bb.falls_through() and bb.fallthrough != NONE and
+            not (k + 1 < order.size() and order[k+1] == bb.fallthrough))
+          out.push_back(instruction(instruction::_UJUMP, target(bb.fallthrough)));
+      }
+    }
+
+    // drop the gotos to the next instruction and the added labels
+    // that no jump uses, and leave the code in the header
+    void finish(size_t fallthrough) {
+      vector<instruction> code;
+      for (size_t k = 0; k < out.size(); ++k)
+        if (not (out[k].oper == instruction::_UJUMP and k + 1 < out.size() and
+                 out[k+1].oper == instruction::_LABEL and out[k+1].arg1 == out[k].arg1))
+          code.push_back(out[k]);
+      set<uint32_t> used;
+      for (const instruction &i : code)
+        if (i.is_jump()) used.insert(i.jump_label().id());
+      basicBlock &h = g.block(l.header);
+      h.instrs.clear();
+      for (const instruction &i : code)
+        if (not (i.oper == instruction::_LABEL and added.count(i.arg1.id()) and
+                 not used.count(i.arg1.id())))
+          h.instrs.push_back(i);
+      h.fallthrough = fallthrough;
+      for (size_t b : l.blocks)
+        if (b != l.header) g.block(b).removed = true;
+    }
+  };
+
+}
+
+// unroll the counted loops of s; returns how many were unrolled
+size_t LoopUnroll::run(subroutine &s, unsigned factor) {
+  FlowGraph g(s);
+  if (g.loops().empty()) return 0;
+  DataFlow df(g);
+
+  // innermost loops do not overlap: find them all, then rewrite them
+  vector<counted> found;
+  for (const FlowGraph::loop &l : g.loops()) {
+    counted c;
+    if (analyze(g, df, l, c)) found.push_back(c);
+  }
+
+  size_t count = 0;
+  for (const counted &c : found) {
+    FlowGraph::loop l = g.loops()[g.loop_with_header(c.header)];
+    unroller u(g, l);
+    if (uint64_t(c.trip) * c.size <= MAX_SIZE) {
+      u.full(c.trip);
+      ++count;
+      continue;
+    }
+    size_t f = factor;
+    while (f >= 2 and (int64_t(f) > c.trip or (f + c.trip % f) * c.size > MAX_SIZE)) --f;
+    if (f < 2) continue;
+    u.partial(f, c.trip % f);
+    ++count;
+  }
+  if (count > 0) g.apply(s);
+  return count;
+}
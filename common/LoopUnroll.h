@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////////
+//
+//    LoopUnroll - Unrolling of loops with a constant trip count
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class LoopUnroll copies the body of counted loops, so that the
+// test and the jumps of the loop run fewer times.
+//
+// A loop is counted when it is innermost, its only exit is the
+// conditional jump at the end of its header, it has a single latch,
+// and that jump tests "i < n" or "i <= n" (or "n < i", "n <= i"),
+// where n is a constant and i a variable that the loop changes only
+// by adding a constant once per iteration, after the test, and that
+// holds a constant when the loop is entered. The trip count is then
+// known, and:
+//
+//  - if the copies of all its iterations take at most MAX_SIZE
+//    instructions, the loop is replaced by them (fully unrolled)
+//  - otherwise, the loop body is repeated 'factor' times (or less,
+//    to stay within MAX_SIZE), with the test only before the first
+//    copy. The iterations left over (trip count modulo the factor)
+//    are copied before the loop.
+//
+// Every copy runs the instructions of the header, as the original
+// loop does, so the tests that are known to hold are left for the
+// dead code elimination. The copies define the same temporals, so
+// the result is not in SSA form (see TempAlloc.h).
+
+class LoopUnroll {
+
+public:
+
+  // unroll the counted loops of s, repeating the body of the large
+  // ones 'factor' times; returns how many loops were unrolled
+  static std::size_t run(subroutine &s, unsigned factor);
+
+  // most instructions that the copies of a loop may take
+  static const std::size_t MAX_SIZE = 128;
+};
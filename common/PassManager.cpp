@@ -0,0 +1,156 @@
+/////////////////////////////////////////////////////////////////
+//
+//    PassManager - Ordered pipeline of t-code passes
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "PassManager.h"
+
+#include <chrono>
+#include <iomanip>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'PassManager'
+
+namespace {
+
+  size_t num_instructions(const code &c) {
+    size_t n = 0;
+    for (const subroutine &s : c.get_subroutine_list()) n += s.get_num_instructions();
+    return n;
+  }
+
+}
+
+// a pass over each subroutine, as a pass over the whole code
+PassManager::runner PassManager::each_subroutine(function<size_t(subroutine &)> run) {
+  return [run](code &c) {
+    size_t changes = 0;
+    for (size_t i = 0; i < c.get_subroutine_list().size(); ++i)
+      changes += run(c.get_subroutine_at(i));
+    return changes;
+  };
+}
+
+// add a pass at the end of the pipeline
+void PassManager::add(const string &name, unsigned level, const runner &run) {
+  passes.push_back(pass{name, level, run, false});
+}
+
+PassManager::pass * PassManager::find(const string &name) {
+  for (pass &p : passes)
+    if (p.name == name) return &p;
+  return nullptr;
+}
+
+const PassManager::pass * PassManager::find(const string &name) const {
+  for (const pass &p : passes)
+    if (p.name == name) return &p;
+  return nullptr;
+}
+
+// switch on the passes of the given level (and lower)
+void PassManager::set_level(unsigned level) {
+  for (pass &p : passes) p.on = p.level > 0 and p.level <= level;
+}
+
+// switch a pass on or off
+bool PassManager::enable(const string &name, bool on) {
+  pass *p = find(name);
+  if (not p) return false;
+  p->on = on;
+  return true;
+}
+
+// apply a list like "name,+name,-name"
+bool PassManager::enable_list(const string &list, string &badName) {
+  size_t from = 0;
+  while (from <= list.size()) {
+    size_t to = list.find(',', from);
+    if (to == string::npos) to = list.size();
+    string item = list.substr(from, to - from);
+    bool on = true;
+    if (not item.empty() and (item[0] == '+' or item[0] == '-')) {
+      on = item[0] == '+';
+      item = item.substr(1);
+    }
+    if (not enable(item, on)) {
+      badName = item;
+      return false;
+    }
+    from = to + 1;
+  }
+  return true;
+}
+
+bool PassManager::enabled(const string &name) const {
+  const pass *p = find(name);
+  return p and p->on;
+}
+
+// names of the passes, in the order they run
+vector<string> PassManager::names() const {
+  vector<string> v;
+  for (const pass &p : passes) v.push_back(p.name);
+  return v;
+}
+
+// run the passes that are on
+void PassManager::run(code &c, Arena *arena) {
+  for (const pass &p : passes) {
+    if (not p.on) continue;
+    if (arena) arena->begin_phase(p.name);
+    stats st{p.name, 0, num_instructions(c), 0, 0};
+    auto start = chrono::steady_clock::now();
+    st.changes = p.run(c);
+    auto end = chrono::steady_clock::now();
+    st.millis = chrono::duration<double, milli>(end - start).count();
+    st.after = num_instructions(c);
+    history.push_back(st);
+  }
+}
+
+// changes, instructions removed and time of each pass that ran
+void PassManager::print_stats(ostream &out) const {
+  out << left << setw(26) << "pass" << right
+      << setw(9) << "changes" << setw(9) << "before" << setw(9) << "after"
+      << setw(9) << "removed" << setw(12) << "time (ms)" << endl;
+  out << fixed << setprecision(3);
+  double total = 0;
+  for (const stats &st : history) {
+    out << left << setw(26) << st.name << right
+        << setw(9) << st.changes << setw(9) << st.before << setw(9) << st.after
+        << setw(9) << long(st.before) - long(st.after) << setw(12) << st.millis << endl;
+    total += st.millis;
+  }
+  if (not history.empty())
+    out << left << setw(26) << "total" << right
+        << setw(9) << "" << setw(9) << history.front().before << setw(9) << history.back().after
+        << setw(9) << long(history.front().before) - long(history.back().after)
+        << setw(12) << total << endl;
+}
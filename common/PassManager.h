@@ -0,0 +1,110 @@
+/////////////////////////////////////////////////////////////////
+//
+//    PassManager - Ordered pipeline of t-code passes
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <functional>
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+#include "Arena.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class PassManager runs the t-code passes, in the order they were
+// added, between code generation and the output of the code.
+//
+// Each pass has the lowest optimization level (-O1, -O2...) that
+// enables it; level 0 means that it runs only when asked for. After
+// set_level(), single passes can still be switched on or off with
+// enable(), or with a list in the format of --passes:
+//
+//    name,+name    switch the passes on
+//    -name         switch the pass off
+//
+// For every pass that runs, the manager measures the time it takes
+// and the number of instructions of the code before and after it.
+
+class PassManager {
+
+public:
+
+  // a pass over the whole code; returns how many changes it made
+  typedef std::function<std::size_t(code &)> runner;
+
+  // a pass over each subroutine, as a pass over the whole code
+  static runner each_subroutine(std::function<std::size_t(subroutine &)> run);
+
+  // add a pass at the end of the pipeline
+  void add(const std::string &name, unsigned level, const runner &run);
+
+  // switch on the passes of the given level (and lower), and off
+  // the rest
+  void set_level(unsigned level);
+  // switch a pass on or off; false if there is no such pass
+  bool enable(const std::string &name, bool on);
+  // apply a list of changes (see above); false (and the wrong name)
+  // if some pass does not exist
+  bool enable_list(const std::string &list, std::string &badName);
+  bool enabled(const std::string &name) const;
+  // names of the passes, in the order they run
+  std::vector<std::string> names() const;
+
+  // run the passes that are on (each one as a phase of the arena,
+  // if given)
+  void run(code &c, Arena *arena = nullptr);
+
+  // changes, instructions removed and time of each pass that ran
+  void print_stats(std::ostream &out) const;
+
+private:
+
+  struct pass {
+    std::string name;
+    unsigned level;
+    runner run;
+    bool on;
+  };
+  struct stats {
+    std::string name;
+    std::size_t changes;
+    std::size_t before, after;
+    double millis;
+  };
+
+  std::vector<pass> passes;
+  std::vector<stats> history;
+
+  pass * find(const std::string &name);
+  const pass * find(const std::string &name) const;
+};
@@ -0,0 +1,198 @@
+/////////////////////////////////////////////////////////////////
+//
+//    StrengthReduce - Induction variable strength reduction
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "StrengthReduce.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <string>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'StrengthReduce'
+
+namespace {
+
+  typedef DataFlow::site site;
+
+  // a basic induction variable: i = i + step, at 'update'
+  struct inductionVar {
+    operand var;
+    site update;
+    int64_t step;
+  };
+
+  // a product to replace: "%j = iv * factor" at 'at'
+  struct product {
+    site at;
+    size_t iv;
+    int64_t factor;
+  };
+
+  // what is going to change in a loop
+  struct plan {
+    vector<inductionVar> ivs;
+    vector<product> products;
+    bool needs_preheader() const {
+      for (const product &p : products)
+        if (p.factor != 1) return true;
+      return false;
+    }
+  };
+
+  // find the basic induction variables of l and the products of
+  // them by a constant
+  plan analyze(const FlowGraph &g, DataFlow &df, const FlowGraph::loop &l) {
+    // variables defined only once in the loop
+    map<uint32_t, pair<unsigned, site>> defs;
+    for (size_t b : l.blocks) {
+      const basicBlock &bb = g.block(b);
+      for (size_t k = 0; k < bb.instrs.size(); ++k) {
+        operand d = bb.instrs[k].def();
+        if (d.empty()) continue;
+        auto &e = defs[DataFlow::key(d)];
+        ++e.first;
+        e.second = site{uint32_t(b), uint32_t(k)};
+      }
+    }
+
+    plan p;
+    map<uint32_t, size_t> ivOf;
+    for (const auto &e : defs) {
+      if (e.second.first != 1) continue;
+      site s = e.second.second;
+      const instruction &i = g.block(s.block).instrs[s.index];
+      operand v = i.def();
+      int64_t step;
+      if (not df.is_increment(s, v, step)) continue;
+      ivOf[DataFlow::key(v)] = p.ivs.size();
+      p.ivs.push_back(inductionVar{v, s, step});
+    }
+    if (p.ivs.empty()) return p;
+
+    for (size_t b : l.blocks) {
+      const basicBlock &bb = g.block(b);
+      for (size_t k = 0; k < bb.instrs.size(); ++k) {
+        const instruction &i = bb.instrs[k];
+        if (i.oper != instruction::_MUL) continue;
+        site s{uint32_t(b), uint32_t(k)};
+        for (int side = 0; side < 2; ++side) {
+          const operand &v = side == 0 ? i.arg2 : i.arg3;
+          const operand &c = side == 0 ? i.arg3 : i.arg2;
+          auto it = ivOf.find(DataFlow::key(v));
+          int64_t factor;
+          if (it == ivOf.end() or c == v or not df.constant_at(s, c, factor)) continue;
+          // the increment k * factor has to be written as a literal
+          int32_t inc = int32_t(uint32_t(p.ivs[it->second].step * factor));
+          if (factor == 0 or inc == INT32_MIN) continue;
+          p.products.push_back(product{s, it->second, factor});
+          break;
+        }
+      }
+    }
+    return p;
+  }
+
+}
+
+// reduce the loops of s; returns how many products were replaced
+size_t StrengthReduce::run(subroutine &s) {
+  FlowGraph g(s);
+  if (g.loops().empty()) return 0;
+  DataFlow df(g);
+
+  size_t count = 0;
+  for (size_t h : g.headers_innermost_first()) {
+    size_t li = g.loop_with_header(h);
+    if (li == FlowGraph::NONE) continue;
+    plan p = analyze(g, df, g.loops()[li]);
+    if (p.products.empty()) continue;
+
+    size_t ph = FlowGraph::NONE;
+    bool added = false;
+    if (p.needs_preheader()) ph = g.preheader_of(li, added);
+    if (added) {
+      df.recompute();
+      p = analyze(g, df, g.loops()[li]);
+    }
+
+    // one new variable per induction variable and factor, that holds
+    // their product
+    map<pair<size_t, int64_t>, operand> reduced;
+    vector<pair<site, instruction>> increments;
+    for (const product &x : p.products) {
+      instruction &i = g.block(x.at.block).instrs[x.at.index];
+      const inductionVar &iv = p.ivs[x.iv];
+      ++count;
+      if (x.factor == 1) {
+        i = instruction(instruction::_LOAD, i.arg1, iv.var);
+        continue;
+      }
+      auto key = make_pair(x.iv, x.factor);
+      auto it = reduced.find(key);
+      if (it == reduced.end()) {
+        operand r = g.new_temp(), c = g.new_temp();
+        basicBlock &pre = g.block(ph);
+        pre.instrs.push_back(instruction(instruction::_ILOAD, c,
+                                         operand(operand::_INT, std::to_string(x.factor))));
+        pre.instrs.push_back(instruction(instruction::_MUL, r, iv.var, c));
+        int32_t inc = int32_t(uint32_t(iv.step * x.factor));
+        if (inc != 0) {
+          operand k = g.new_temp();
+          pre.instrs.push_back(instruction(instruction::_ILOAD, k,
+                                           operand(operand::_INT, std::to_string(std::abs(int64_t(inc))))));
+          increments.push_back(make_pair(iv.update,
+                                         instruction(inc > 0 ? instruction::_ADD : instruction::_SUB, r, r, k)));
+        }
+        it = reduced.insert(make_pair(key, r)).first;
+      }
+      i = instruction(instruction::_LOAD, i.arg1, it->second);
+    }
+    // the increments go right after the updates, last positions first
+    sort(increments.begin(), increments.end(),
+         [](const pair<site, instruction> &a, const pair<site, instruction> &b) {
+           return a.first.block != b.first.block ? a.first.block < b.first.block
+                                                 : a.first.index > b.first.index;
+         });
+    for (const auto &inc : increments) {
+      arenaVector<instruction> &code = g.block(inc.first.block).instrs;
+      code.insert(code.begin() + inc.first.index + 1, inc.second);
+    }
+    df.recompute();
+  }
+  if (count > 0) g.apply(s);
+  return count;
+}
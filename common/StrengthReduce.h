@@ -0,0 +1,58 @@
+/////////////////////////////////////////////////////////////////
+//
+//    StrengthReduce - Induction variable strength reduction
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class StrengthReduce replaces, inside natural loops, the products
+// of an induction variable by a constant with additions.
+//
+// A basic induction variable i has a single definition in the loop,
+// "i = i + k" or "i = i - k" (directly, or through a temporal
+// "%t = i + k; i = %t"), with k a constant. For every product
+// "%j = i * c" in the loop (the offset of a[i] is one of them) a new
+// temporal s is set to i * c in the preheader of the loop and
+// increased by k * c right after i is; the product becomes "%j = s".
+// When c is 1 the product is simply "%j = i".
+//
+// Inner loops are reduced before the loops that contain them.
+
+class StrengthReduce {
+
+public:
+
+  // reduce the loops of s; returns how many products were replaced
+  static std::size_t run(subroutine &s);
+};
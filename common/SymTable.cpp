@@ -49,37 +49,63 @@ SymTable::SymTable(TypesMgr & Types) :
   Types{Types} {
 }
 
+// Stack of scopes used by the calling thread: its own one while a
+// ThreadScopes object is alive, or the one shared by all threads
+thread_local std::vector<SymTable::ScopeId> * SymTable::ThreadStack = nullptr;
+thread_local const SymTable * SymTable::ThreadOwner = nullptr;
+
+std::vector<SymTable::ScopeId> & SymTable::scopeStack() {
+  return ThreadOwner == this ? *ThreadStack : ScopeIdsStack;
+}
+
+const std::vector<SymTable::ScopeId> & SymTable::scopeStack() const {
+  return ThreadOwner == this ? *ThreadStack : ScopeIdsStack;
+}
+
+SymTable::ThreadScopes::ThreadScopes(SymTable & Symbols) :
+  Stack{Symbols.ScopeIdsStack},
+  PrevStack{ThreadStack},
+  PrevOwner{ThreadOwner} {
+  ThreadStack = &Stack;
+  ThreadOwner = &Symbols;
+}
+
+SymTable::ThreadScopes::~ThreadScopes() {
+  ThreadStack = PrevStack;
+  ThreadOwner = PrevOwner;
+}
+
 // Creates a new scope, push its ScopeId in the stack
 // and returns this ScopeId.
 SymTable::ScopeId SymTable::pushNewScope(const std::string & name) {
   ScopeId currScope = ScopesVec.size();
   ScopesVec.push_back(ScopeInfo(name));
-  ScopeIdsStack.push_back(currScope);
+  scopeStack().push_back(currScope);
   return currScope;
 }
 
 // Pop the stack of scopes
 void SymTable::popScope() {
-  assert(not ScopeIdsStack.empty());
-  ScopeIdsStack.pop_back();
+  assert(not scopeStack().empty());
+  scopeStack().pop_back();
 }
 
 // Push a previously created scope sc and set it as current scope
 void SymTable::pushThisScope(ScopeId scope) {
   assert(scope < ScopesVec.size());
-  ScopeIdsStack.push_back(scope);
+  scopeStack().push_back(scope);
 }
 
 // Returns the current scope.
 SymTable::ScopeId SymTable::topScope() const {
-  assert(not ScopeIdsStack.empty());
-  return ScopeIdsStack.back();
+  assert(not scopeStack().empty());
+  return scopeStack().back();
 }
 
 // Returns true if ident occurs in the current scope (top of the stack)
 bool SymTable::findInCurrentScope(const std::string & ident) const {
-  assert(not ScopeIdsStack.empty());
-  ScopeId currScope = ScopeIdsStack.back();
+  assert(not scopeStack().empty());
+  ScopeId currScope = scopeStack().back();
   assert(currScope < ScopesVec.size());
   return (ScopesVec[currScope].findSymbol(ident));
 }
@@ -89,10 +115,10 @@ bool SymTable::findInCurrentScope(const std::string & ident) const {
 // If it occurs in the scope below the top returns 1, and so on.
 // Returns -1 if te symbol is not found.
 int SymTable::findInStack(const std::string & ident) const {
-  assert(not ScopeIdsStack.empty());
+  assert(not scopeStack().empty());
   int d = 0;
-  for (int i = ScopeIdsStack.size() - 1; i >= 0; --i) {
-    ScopeId sc = ScopeIdsStack[i];
+  for (int i = scopeStack().size() - 1; i >= 0; --i) {
+    ScopeId sc = scopeStack()[i];
     assert(sc < ScopesVec.size());
     if (ScopesVec[sc].findSymbol(ident))
       return d;
@@ -103,30 +129,30 @@ int SymTable::findInStack(const std::string & ident) const {
 
 // Adds a new symbol in the current scope.
 void SymTable::addLocalVar(const std::string & ident, TypesMgr::TypeId type) {
-  assert(not ScopeIdsStack.empty());
-  ScopeId currScope = ScopeIdsStack.back();
+  assert(not scopeStack().empty());
+  ScopeId currScope = scopeStack().back();
   assert(currScope < ScopesVec.size());
   ScopesVec[currScope].addLocalVar(ident, type);
 }
 void SymTable::addParameter(const std::string & ident, TypesMgr::TypeId type) {
-  assert(not ScopeIdsStack.empty());
-  ScopeId currScope = ScopeIdsStack.back();
+  assert(not scopeStack().empty());
+  ScopeId currScope = scopeStack().back();
   assert(currScope < ScopesVec.size());
   ScopesVec[currScope].addParameter(ident, type);
 }
 
 void SymTable::addFunction(const std::string & ident, TypesMgr::TypeId type) {
-  assert(not ScopeIdsStack.empty());
-  ScopeId currScope = ScopeIdsStack.back();
+  assert(not scopeStack().empty());
+  ScopeId currScope = scopeStack().back();
   assert(currScope < ScopesVec.size());
   ScopesVec[currScope].addFunction(ident, type);
 }
 
 // Check the class of a symbol. If not found return false
 bool SymTable::isLocalVarClass(const std::string & ident) const {
-  assert(not ScopeIdsStack.empty());
-  for (int i = ScopeIdsStack.size() - 1; i >= 0; --i) {
-    ScopeId sc = ScopeIdsStack[i];
+  assert(not scopeStack().empty());
+  for (int i = scopeStack().size() - 1; i >= 0; --i) {
+    ScopeId sc = scopeStack()[i];
     assert(sc < ScopesVec.size());
     if (ScopesVec[sc].findSymbol(ident))
       return ScopesVec[sc].isLocalVarClass(ident);
@@ -135,9 +161,9 @@ bool SymTable::isLocalVarClass(const std::string & ident) const {
 }
 
 bool SymTable::isParameterClass(const std::string & ident) const {
-  assert(not ScopeIdsStack.empty());
-  for (int i = ScopeIdsStack.size() - 1; i >= 0; --i) {
-    ScopeId sc = ScopeIdsStack[i];
+  assert(not scopeStack().empty());
+  for (int i = scopeStack().size() - 1; i >= 0; --i) {
+    ScopeId sc = scopeStack()[i];
     assert(sc < ScopesVec.size());
     if (ScopesVec[sc].findSymbol(ident))
       return ScopesVec[sc].isParameterClass(ident);
@@ -146,9 +172,9 @@ bool SymTable::isParameterClass(const std::string & ident) const {
 }
 
 bool SymTable::isFunctionClass(const std::string & ident) const {
-  assert(not ScopeIdsStack.empty());
-  for (int i = ScopeIdsStack.size() - 1; i >= 0; --i) {
-    ScopeId sc = ScopeIdsStack[i];
+  assert(not scopeStack().empty());
+  for (int i = scopeStack().size() - 1; i >= 0; --i) {
+    ScopeId sc = scopeStack()[i];
     assert(sc < ScopesVec.size());
     if (ScopesVec[sc].findSymbol(ident))
       return ScopesVec[sc].isFunctionClass(ident);
@@ -158,9 +184,9 @@ bool SymTable::isFunctionClass(const std::string & ident) const {
 
 // Get the TypeId of a symbol. If not found return type 'error'
 TypesMgr::TypeId SymTable::getType(const std::string & ident) const {
-  assert(not ScopeIdsStack.empty());
-  for (int i = ScopeIdsStack.size() - 1; i >= 0; --i) {
-    ScopeId sc = ScopeIdsStack[i];
+  assert(not scopeStack().empty());
+  for (int i = scopeStack().size() - 1; i >= 0; --i) {
+    ScopeId sc = scopeStack()[i];
     assert(sc < ScopesVec.size());
     if (ScopesVec[sc].findSymbol(ident))
       return ScopesVec[sc].getType(ident);
@@ -169,8 +195,8 @@ TypesMgr::TypeId SymTable::getType(const std::string & ident) const {
 }
 
 bool SymTable::noMainProperlyDeclared() const {
-  assert(not ScopeIdsStack.empty());
-  ScopeId currScope = ScopeIdsStack.back();
+  assert(not scopeStack().empty());
+  ScopeId currScope = scopeStack().back();
   assert(currScope < ScopesVec.size());
   if ((not ScopesVec[currScope].findSymbol("main")) or
       (not ScopesVec[currScope].isFunctionClass("main")))
@@ -205,8 +231,8 @@ TypesMgr::TypeId SymTable::getLocalSymbolType(const std::string & funcName,
 // Writes the contents of the current scope (top of the stack)
 // on the standard output.
 void SymTable::printCurrentScope() const {
-  assert(not ScopeIdsStack.empty());
-  ScopeId currScope = ScopeIdsStack.back();
+  assert(not scopeStack().empty());
+  ScopeId currScope = scopeStack().back();
   assert(currScope < ScopesVec.size());
   ScopesVec[currScope].print(Types);
 }
@@ -214,8 +240,8 @@ void SymTable::printCurrentScope() const {
 // Write the contents of the symbol table on the standard output
 void SymTable::print() const {
   std::cout << "Contents of symbol table:" << std::endl;
-  for (int i = ScopeIdsStack.size() - 1; i >= 0; --i) {
-    ScopeId sc = ScopeIdsStack[i];
+  for (int i = scopeStack().size() - 1; i >= 0; --i) {
+    ScopeId sc = scopeStack()[i];
     assert(sc < ScopesVec.size());
     ScopesVec[sc].print(Types);
   }
@@ -112,6 +112,22 @@ public:
   TypesMgr::TypeId getLocalSymbolType    (const std::string & funcName,
                                           const std::string & ident) const;
 
+  // Class ThreadScopes gives the calling thread its own stack of
+  // scopes (a copy of the current one) while the object is alive, so
+  // that several threads can walk different functions at the same
+  // time. No scope or symbol may be added while threads use the table.
+  class ThreadScopes {
+  public:
+    explicit ThreadScopes (SymTable & Symbols);
+    ~ThreadScopes ();
+    ThreadScopes (const ThreadScopes &) = delete;
+    ThreadScopes & operator= (const ThreadScopes &) = delete;
+  private:
+    std::vector<ScopeId>   Stack;
+    std::vector<ScopeId> * PrevStack;
+    const SymTable       * PrevOwner;
+  };
+
   // Print the symbols of a scope on the standard output
   //   - the symbols of the current scope (top of the stack)
   void printCurrentScope () const;
@@ -128,6 +144,12 @@ private:
   std::vector<ScopeInfo>   ScopesVec;
   std::vector<ScopeId>     ScopeIdsStack;
 
+  // Stack of scopes of the calling thread, if it has one (see ThreadScopes)
+  static thread_local std::vector<ScopeId> * ThreadStack;
+  static thread_local const SymTable       * ThreadOwner;
+  std::vector<ScopeId>       & scopeStack ();
+  const std::vector<ScopeId> & scopeStack () const;
+
   //////////////////////////////////////////////////////////////////
   // Class ScopeInfo: is declared inside SymTable and is private,
   // so only the SymTable can operate with Scope objects.
@@ -0,0 +1,203 @@
+/////////////////////////////////////////////////////////////////
+//
+//    TailRecursion - Self tail calls turned into jumps
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "TailRecursion.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'TailRecursion'
+
+namespace {
+
+  const string RESULT = "_result";
+  const string ACC    = "_acc";
+  const string ENTRY  = "_entry";
+
+  // a self call that can be turned into a jump
+  struct site {
+    size_t call;              // position of the call
+    vector<size_t> push;      // position of the push of each param
+    vector<size_t> gone;      // pops and copies of the result
+    instruction::Operation op; // _ADD or _MUL with an accumulator, _NOOP if none
+    operand other;            // the other operand of op
+  };
+
+  // how many instructions of code read o
+  size_t readers(const vector<instruction> &code, const operand &o) {
+    size_t n = 0;
+    operand u[3];
+    for (const instruction &i : code) {
+      int k = i.uses(u);
+      n += count(u, u + k, o);
+    }
+    return n;
+  }
+
+  // position of the first instruction from k that is not a label
+  size_t skip_labels(const vector<instruction> &code, size_t k) {
+    while (k < code.size() and code[k].oper == instruction::_LABEL) ++k;
+    return k;
+  }
+
+  // true if the instruction at k of code returns
+  bool returns_at(const vector<instruction> &code, size_t k) {
+    k = skip_labels(code, k);
+    return k < code.size() and code[k].oper == instruction::_RETURN;
+  }
+
+}
+
+// turn the self tail calls of s into jumps; returns how many
+size_t TailRecursion::run(subroutine &s) {
+  vector<instruction> code(s.get_instructions().begin(), s.get_instructions().end());
+  const vector<var> params(s.params.begin(), s.params.end());
+  size_t n = code.size(), np = params.size();
+  bool hasResult = np > 0 and params[0].name == RESULT;
+  operand result = hasResult ? operand(operand::_PARAM, RESULT) : operand();
+  operand acc(operand::_VAR, ACC);
+  operand entry(operand::_LABEL, ENTRY);
+  // already done (the entry label cannot be added twice)
+  for (const instruction &i : code)
+    if (i.oper == instruction::_LABEL and i.arg1 == entry) return 0;
+
+  vector<site> sites;
+  for (size_t pc = 0; pc < n; ++pc) {
+    if (code[pc].oper != instruction::_CALL or code[pc].arg1.to_string() != s.get_name())
+      continue;
+    site t{pc, vector<size_t>(np), {}, instruction::_NOOP, operand()};
+
+    // the pushes of this call (skipping those of the calls made while
+    // computing the arguments) and its pops
+    size_t depth = 0, found = 0;
+    for (size_t k = pc; k-- > 0 and found < np; ) {
+      if (code[k].oper == instruction::_POP) ++depth;
+      else if (code[k].oper == instruction::_PUSH) {
+        if (depth > 0) --depth;
+        else t.push[np - ++found] = k;
+      }
+    }
+    bool ok = found == np;
+    for (size_t k = 1; ok and k <= np; ++k) {
+      ok = pc + k < n and code[pc+k].oper == instruction::_POP and
+           (code[pc+k].arg1.empty() or (hasResult and k == np));
+      if (ok) t.gone.push_back(pc + k);
+    }
+    for (size_t k = hasResult; ok and k < np; ++k)
+      ok = not params[k].is_array() or code[t.push[k]].arg1.kind() == operand::_PARAM;
+    if (not ok) continue;
+
+    // what is done with the result before returning it
+    size_t next = pc + np + 1;
+    if (not hasResult) ok = returns_at(code, next);
+    else {
+      operand r = code[pc+np].arg1;
+      const instruction *i = next < n ? &code[next] : nullptr;
+      if (r == result)
+        ok = returns_at(code, next);
+      else if (not r.is_temp() or readers(code, r) != 1 or not i)
+        ok = false;
+      else if (i->oper == instruction::_LOAD and i->arg1 == result and i->arg2 == r) {
+        ok = returns_at(code, next + 1);
+        t.gone.push_back(next);
+      }
+      else if ((i->oper == instruction::_MUL or i->oper == instruction::_ADD) and
+               (i->arg2 == r) != (i->arg3 == r)) {
+        t.op = i->oper;
+        t.other = i->arg2 == r ? i->arg3 : i->arg2;
+        t.gone.push_back(next);
+        if (i->arg1 == result) ok = returns_at(code, next + 1);
+        else
+          ok = i->arg1.is_temp() and readers(code, i->arg1) == 1 and next + 1 < n and
+               code[next+1].oper == instruction::_LOAD and code[next+1].arg1 == result and
+               code[next+1].arg2 == i->arg1 and returns_at(code, next + 2);
+        if (ok and i->arg1 != result) t.gone.push_back(next + 1);
+      }
+      else ok = false;
+    }
+    if (ok) sites.push_back(t);
+  }
+
+  // a single operation for the accumulator
+  instruction::Operation accOp = instruction::_NOOP;
+  vector<site> kept;
+  for (const site &t : sites) {
+    if (t.op != instruction::_NOOP and accOp == instruction::_NOOP) accOp = t.op;
+    if (t.op == instruction::_NOOP or t.op == accOp) kept.push_back(t);
+  }
+  if (kept.empty()) return 0;
+
+  uint32_t nextTemp = 0;
+  for (const instruction &i : code)
+    for (const operand *a : {&i.arg1, &i.arg2, &i.arg3})
+      if (a->is_temp()) nextTemp = max(nextTemp, a->id());
+
+  // what replaces the instructions of each call
+  vector<bool> replaced(n, false);
+  vector<vector<instruction>> with(n);
+  for (const site &t : kept) {
+    for (size_t k : t.gone) replaced[k] = true;
+    replaced[t.call] = true;
+    vector<instruction> &jump = with[t.call];
+    if (t.op != instruction::_NOOP) jump.push_back(instruction(t.op, acc, acc, t.other));
+    for (size_t k = 0; k < np; ++k) {
+      replaced[t.push[k]] = true;
+      if (hasResult and k == 0) continue;
+      // a param passed on unchanged keeps its value
+      if (code[t.push[k]].arg1 == operand(operand::_PARAM, params[k].name)) continue;
+      operand arg = operand::make(operand::_TEMP, ++nextTemp);
+      with[t.push[k]].push_back(instruction(instruction::_LOAD, arg, code[t.push[k]].arg1));
+      jump.push_back(instruction(instruction::_LOAD, operand(operand::_VAR, params[k].name), arg));
+    }
+    jump.push_back(instruction(instruction::_UJUMP, entry));
+  }
+
+  instructionList out;
+  if (accOp != instruction::_NOOP) {
+    s.add_var(ACC, params[0].type);
+    out = instruction(instruction::_ILOAD, acc,
+                      operand(operand::_INT, accOp == instruction::_MUL ? "1" : "0"));
+  }
+  out = out || instruction(instruction::_LABEL, entry);
+  for (size_t pc = 0; pc < n; ++pc) {
+    if (replaced[pc]) {
+      for (const instruction &i : with[pc]) out = out || i;
+      continue;
+    }
+    if (code[pc].oper == instruction::_RETURN and accOp != instruction::_NOOP)
+      out = out || instruction(accOp, result, acc, result);
+    out = out || code[pc];
+  }
+  s.set_instructions(out);
+  return kept.size();
+}
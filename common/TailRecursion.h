@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////////
+//
+//    TailRecursion - Self tail calls turned into jumps
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class TailRecursion removes the calls a subroutine makes to itself
+// when their result is returned right away:
+//
+//    pushparam                          %t1 = a
+//    pushparam a                        (the code of the arguments)
+//    call f                 becomes     n = %t1
+//    popparam                           goto _entry
+//    popparam %r
+//    _result = %r
+//    return
+//
+// The arguments are kept in temporals until all of them have been
+// computed, then they are copied into the params and the code jumps
+// to the label _entry, added at the beginning of the subroutine.
+//
+// An integer recursion that is linear, like "return n * f(n-1)" or
+// "return f(n-1) + n", gets an accumulator _acc. It is set to 1 (or
+// 0) on entry, and the call becomes "_acc = _acc * n" and the jump.
+// Every return then gives "_result = _acc * _result". All these calls
+// in a subroutine must use the same operation (* or +).
+//
+// An array can only be passed on when it is a param itself. The
+// address of a local array would point into the frame that is
+// reused.
+
+class TailRecursion {
+
+public:
+
+  // turn the self tail calls of s into jumps; returns how many
+  static std::size_t run(subroutine &s);
+};
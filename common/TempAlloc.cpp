@@ -0,0 +1,150 @@
+/////////////////////////////////////////////////////////////////
+//
+//    TempAlloc - Packing of the temporals of t-code subroutines
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "TempAlloc.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for struct 'TempAlloc::stats'
+
+// slots saved in the subroutine
+size_t TempAlloc::stats::saved() const {
+  return before - after;
+}
+
+// one line: the subroutine, its temporals, slots and slots saved
+void TempAlloc::stats::print(ostream &out) const {
+  out << "pack-temps: " << name << ": " << before << " temporals -> "
+      << after << " slots (" << saved() << " saved)" << endl;
+}
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'TempAlloc'
+
+namespace {
+
+  // positions where a temporal may hold a value. Instruction number p
+  // reads its operands at 2p and writes its result at 2p+1, so a temporal
+  // last read by an instruction can share the slot with the one it defines.
+  struct interval {
+    size_t start, end;
+    size_t var;       // index in the DataFlow
+    bool used;
+  };
+
+  void extend(interval &it, size_t pos) {
+    if (not it.used) {
+      it.start = it.end = pos;
+      it.used = true;
+    }
+    else {
+      it.start = min(it.start, pos);
+      it.end = max(it.end, pos);
+    }
+  }
+
+}
+
+// pack the temporals of s (they are renamed %1, %2, ...)
+TempAlloc::stats TempAlloc::pack(subroutine &s) {
+  FlowGraph g(s);
+  DataFlow df(g);
+  size_t nv = df.num_vars();
+
+  // lifetime of every temporal, numbering instructions in layout order
+  vector<interval> lives(nv);
+  for (size_t v = 0; v < nv; ++v) {
+    lives[v].var = v;
+    lives[v].used = false;
+  }
+  size_t pc = 0;
+  vector<bitSet> after;
+  operand u[3];
+  for (size_t b : g.layout()) {
+    const basicBlock &bb = g.block(b);
+    if (bb.removed or bb.instrs.empty()) continue;
+    size_t first = pc;
+    df.live_in(b).for_each([&](size_t v) { extend(lives[v], 2*first); });
+    df.live_after(b, after);
+    for (size_t k = 0; k < bb.instrs.size(); ++k, ++pc) {
+      const instruction &i = bb.instrs[k];
+      int n = i.uses(u);
+      for (int j = 0; j < n; ++j) extend(lives[df.var_index(u[j])], 2*pc);
+      operand d = i.def();
+      if (not d.empty()) extend(lives[df.var_index(d)], 2*pc+1);
+      // live after an instruction: alive until the next one reads
+      after[k].for_each([&](size_t v) { extend(lives[v], 2*pc+1); });
+    }
+  }
+
+  vector<interval> temps;
+  for (const interval &it : lives)
+    if (it.used and df.var_at(it.var).is_temp()) temps.push_back(it);
+  sort(temps.begin(), temps.end(),
+       [](const interval &a, const interval &b) { return a.start < b.start; });
+
+  // linear scan: take the free slot with the lowest number (intervals
+  // are processed by start, so the number of slots is the maximum
+  // number of temporals alive at the same time)
+  vector<size_t> slotEnd;                  // end of the last interval in each slot
+  vector<uint32_t> slotOf(nv, 0);
+  for (const interval &it : temps) {
+    size_t slot = 0;
+    while (slot < slotEnd.size() and slotEnd[slot] >= it.start) ++slot;
+    if (slot == slotEnd.size()) slotEnd.push_back(it.end);
+    else slotEnd[slot] = it.end;
+    slotOf[it.var] = slot + 1;
+  }
+
+  // rename
+  instructionList code;
+  for (const instruction &i : s.get_instructions()) {
+    instruction r = i;
+    for (operand *a : {&r.arg1, &r.arg2, &r.arg3})
+      if (a->is_temp()) {
+        size_t v = df.var_index(*a);
+        *a = operand::make(operand::_TEMP, slotOf[v]);
+      }
+    code = code || r;
+  }
+  s.set_instructions(code);
+
+  stats st;
+  st.name = s.get_name();
+  st.before = temps.size();
+  st.after = slotEnd.size();
+  return st;
+}
@@ -0,0 +1,68 @@
+/////////////////////////////////////////////////////////////////
+//
+//    TempAlloc - Packing of the temporals of t-code subroutines
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+#include <string>
+#include <ostream>
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class TempAlloc renames the temporals of a subroutine so that
+// temporals whose lifetimes do not overlap share the same name (the
+// same slot in the frame of the VM). Lifetimes come from liveness
+// over the control flow graph (see DataFlow), and slots are assigned
+// with a linear scan over the blocks in layout order.
+//
+// Reusing temporals breaks the SSA form that LLVMCodeGen expects, so
+// the packed code is only meant for the t-code output.
+
+class TempAlloc {
+
+public:
+
+  // number of temporals before and after packing a subroutine
+  struct stats {
+    std::string name;
+    std::size_t before;
+    std::size_t after;
+
+    // slots saved in the subroutine
+    std::size_t saved() const;
+    // one line: the subroutine, its temporals, slots and slots saved
+    void print(std::ostream &out) const;
+  };
+
+  // pack the temporals of s (they are renamed %1, %2, ...)
+  static stats pack(subroutine &s);
+};
@@ -35,30 +35,46 @@
 #include "antlr4-runtime.h"
 
 #include <string>
+// uncomment to disable assert()
+// #define NDEBUG
+#include <cassert>
 
 
+template <class V>
+V TreeDecoration::find(const property<V> &decor, antlr4::ParserRuleContext *ctx) {
+  auto it = decor.find(ctx);
+  return it == decor.end() ? V() : it->second;
+}
+
 // Getters:
 SymTable::ScopeId TreeDecoration::getScope(antlr4::ParserRuleContext *ctx) {
-  return ScopeDecor.get(ctx);
+  return find(ScopeDecor, ctx);
 }
 
 TypesMgr::TypeId TreeDecoration::getType(antlr4::ParserRuleContext *ctx) {
-  return TypeDecor.get(ctx);
+  return find(TypeDecor, ctx);
 }
 
 bool TreeDecoration::getIsLValue(antlr4::ParserRuleContext *ctx) {
-  return IsLValueDecor.get(ctx);
+  return find(IsLValueDecor, ctx);
 }
 
 // Setters:
 void TreeDecoration::putScope(antlr4::ParserRuleContext *ctx, SymTable::ScopeId s) {
-  ScopeDecor.put(ctx, s);
+  assert(not Frozen);
+  ScopeDecor[ctx] = s;
 }
 
 void TreeDecoration::putType(antlr4::ParserRuleContext *ctx, TypesMgr::TypeId t) {
-  TypeDecor.put(ctx, t);
+  assert(not Frozen);
+  TypeDecor[ctx] = t;
 }
 
 void TreeDecoration::putIsLValue(antlr4::ParserRuleContext *ctx, bool b) {
-  IsLValueDecor.put(ctx, b);
+  assert(not Frozen);
+  IsLValueDecor[ctx] = b;
+}
+
+void TreeDecoration::freeze() {
+  Frozen = true;
 }
@@ -33,7 +33,8 @@
 #include "SymTable.h"
 
 #include "antlr4-runtime.h"
-#include "tree/ParseTreeProperty.h"
+
+#include <unordered_map>
 
 // using namespace std;
 
@@ -59,6 +60,9 @@
 //   - CodeGenVisitor     [Code Generation]
 //       * access the scope attribute
 //       * access the type attribute
+// Once the tree is checked, freeze() ends the setting: after that
+// the attributes are only read, and getting one does not modify
+// anything, so the threads generating code read them with no lock.
 
 class TreeDecoration {
 
@@ -70,14 +74,25 @@ public:
   TypesMgr::TypeId  getType     (antlr4::ParserRuleContext *ctx);
   bool              getIsLValue (antlr4::ParserRuleContext *ctx);
 
-  // Setters:
+  // Setters (not allowed once frozen):
   void putScope    (antlr4::ParserRuleContext *ctx, SymTable::ScopeId s);
   void putType     (antlr4::ParserRuleContext *ctx, TypesMgr::TypeId t);
   void putIsLValue (antlr4::ParserRuleContext *ctx, bool b);
 
+  // No more attributes will be set (before generating code)
+  void freeze();
+
 private:
-  antlr4::tree::ParseTreeProperty<SymTable::ScopeId> ScopeDecor;
-  antlr4::tree::ParseTreeProperty<TypesMgr::TypeId>  TypeDecor;
-  antlr4::tree::ParseTreeProperty<bool>              IsLValueDecor;
+  // unset attributes are read as a default value (as with
+  // antlr4::tree::ParseTreeProperty, but without inserting it)
+  template <class V>
+  using property = std::unordered_map<antlr4::ParserRuleContext *, V>;
+  template <class V>
+  static V find(const property<V> &decor, antlr4::ParserRuleContext *ctx);
+
+  property<SymTable::ScopeId> ScopeDecor;
+  property<TypesMgr::TypeId>  TypeDecor;
+  property<bool>              IsLValueDecor;
+  bool                        Frozen = false;
 
 };  // class TreeDecoration
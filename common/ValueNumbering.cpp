@@ -0,0 +1,239 @@
+/////////////////////////////////////////////////////////////////
+//
+//    ValueNumbering - Local value numbering on t-code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#include "ValueNumbering.h"
+#include "FlowGraph.h"
+#include "DataFlow.h"
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+/// Implementation for class 'ValueNumbering'
+
+namespace {
+
+  bool commutative(instruction::Operation op) {
+    return op == instruction::_ADD or op == instruction::_MUL or
+           op == instruction::_EQ  or op == instruction::_AND or
+           op == instruction::_OR  or op == instruction::_FADD or
+           op == instruction::_FMUL or op == instruction::_FEQ;
+  }
+
+  // instructions whose result depends only on their operands (and
+  // on memory, for the reads)
+  bool numbered(const instruction &i) {
+    switch (i.oper) {
+    case instruction::_ADD: case instruction::_SUB: case instruction::_MUL:
+    case instruction::_DIV: case instruction::_EQ:  case instruction::_LT:
+    case instruction::_LE:  case instruction::_NEG: case instruction::_NOT:
+    case instruction::_AND: case instruction::_OR:  case instruction::_FLOAT:
+    case instruction::_FADD: case instruction::_FSUB: case instruction::_FMUL:
+    case instruction::_FDIV: case instruction::_FEQ:  case instruction::_FLT:
+    case instruction::_FLE:  case instruction::_FNEG: case instruction::_ALOAD:
+    case instruction::_LOADX: case instruction::_LOADC:
+      return true;
+    case instruction::_ILOAD: case instruction::_FLOAD: case instruction::_CHLOAD:
+      return i.arg2.is_literal();
+    default:
+      return false;
+    }
+  }
+
+  bool reads_memory(instruction::Operation op) {
+    return op == instruction::_LOADX or op == instruction::_LOADC;
+  }
+
+  bool writes_memory(instruction::Operation op) {
+    return op == instruction::_XLOAD or op == instruction::_CLOAD or op == instruction::_BCOPY or
+           op == instruction::_CALL;
+  }
+
+  // value numbers of one block
+  class numbering {
+  public:
+    numbering() : epoch(0) {}
+
+    // number of the value of an operand (a new one if it is unknown)
+    uint32_t value_of(const operand &o) {
+      auto it = current.find(DataFlow::key(o));
+      if (it != current.end()) return it->second;
+      uint32_t v = fresh();
+      set(o, v);
+      return v;
+    }
+
+    // o holds now value v
+    void set(const operand &o, uint32_t v) {
+      current[DataFlow::key(o)] = v;
+      holders[v].push_back(o);
+    }
+
+    uint32_t fresh() {
+      holders.push_back(vector<operand>());
+      return holders.size() - 1;
+    }
+
+    // oldest operand still holding v (empty if none), that may be
+    // used in the given slot
+    operand holder(uint32_t v, bool addressSlot) {
+      for (const operand &o : holders[v])
+        if (current[DataFlow::key(o)] == v and not (addressSlot and o.kind() == operand::_PARAM))
+          return o;
+      return operand();
+    }
+
+    // expression computed by i, with its operands already numbered
+    typedef tuple<int, uint32_t, uint32_t, uint32_t> expr;
+    expr expression(const instruction &i) {
+      uint32_t a = 0, b = 0;
+      if (i.arg2.is_literal() or i.arg2.is_address()) a = value_of(i.arg2);
+      if (i.arg3.is_literal() or i.arg3.is_address()) b = value_of(i.arg3);
+      if (commutative(i.oper) and b < a) swap(a, b);
+      return expr(i.oper, a, b, reads_memory(i.oper) ? epoch : 0);
+    }
+
+    map<expr, uint32_t> exprs;
+    unsigned epoch;
+
+  private:
+    unordered_map<uint32_t, uint32_t> current;
+    vector<vector<operand>> holders;
+  };
+
+}
+
+// number the values of s; returns how many instructions were
+// replaced or removed
+size_t ValueNumbering::run(subroutine &s) {
+  FlowGraph g(s);
+  size_t count = 0;
+  vector<bool> touched(g.num_blocks(), false);
+  for (size_t b = 0; b < g.num_blocks(); ++b) {
+    basicBlock &bb = g.block(b);
+    if (bb.removed) continue;
+    numbering vn;
+    arenaVector<instruction> code;
+    for (instruction i : bb.instrs) {
+      // read every value from its oldest holder
+      operand *u[3];
+      int n = i.use_slots(u);
+      for (int j = 0; j < n; ++j) {
+        operand h = vn.holder(vn.value_of(*u[j]), i.is_address_slot(u[j]));
+        if (not h.empty() and h != *u[j]) {
+          *u[j] = h;
+          touched[b] = true;
+        }
+      }
+
+      operand d = i.def();
+      if (i.is_copy()) {
+        uint32_t v = vn.value_of(i.arg2);
+        if (vn.value_of(d) == v) {     // d has the value already
+          ++count;
+          touched[b] = true;
+          continue;
+        }
+        vn.set(d, v);
+      }
+      else if (numbered(i) and not d.empty()) {
+        numbering::expr e = vn.expression(i);
+        auto it = vn.exprs.find(e);
+        if (it != vn.exprs.end()) {
+          uint32_t v = it->second;
+          operand h = vn.holder(v, false);
+          if (vn.value_of(d) == v) {
+            ++count;
+            touched[b] = true;
+            continue;
+          }
+          if (not h.empty()) {
+            i = instruction(instruction::_LOAD, d, h);
+            ++count;
+            touched[b] = true;
+          }
+          vn.set(d, v);
+        }
+        else {
+          uint32_t v = vn.fresh();
+          vn.exprs[e] = v;
+          vn.set(d, v);
+        }
+      }
+      else if (not d.empty())
+        vn.set(d, vn.fresh());
+
+      if (writes_memory(i.oper)) {
+        ++vn.epoch;
+        // a read of the element just written gives the value stored
+        if (i.oper == instruction::_XLOAD)
+          vn.exprs[numbering::expr(instruction::_LOADX, vn.value_of(i.arg1),
+                                   vn.value_of(i.arg2), vn.epoch)] = vn.value_of(i.arg3);
+      }
+      code.push_back(i);
+    }
+    if (touched[b]) bb.instrs.swap(code);
+  }
+  bool any = false;
+  for (bool t : touched) any = any or t;
+  if (not any) return 0;
+
+  // remove the copies to temporals left without readers
+  DataFlow df(g);
+  for (size_t b = 0; b < g.num_blocks(); ++b) {
+    basicBlock &bb = g.block(b);
+    if (bb.removed or not touched[b]) continue;
+    bitSet alive = df.live_out(b);
+    vector<bool> keep(bb.instrs.size(), true);
+    operand u[3];
+    for (size_t k = bb.instrs.size(); k-- > 0; ) {
+      const instruction &i = bb.instrs[k];
+      operand d = i.def();
+      if (i.is_copy() and d.is_temp() and not alive.test(df.var_index(d))) {
+        keep[k] = false;
+        ++count;
+        continue;
+      }
+      if (not d.empty()) alive.reset(df.var_index(d));
+      int n = i.uses(u);
+      for (int j = 0; j < n; ++j) alive.set(df.var_index(u[j]));
+    }
+    arenaVector<instruction> code;
+    for (size_t k = 0; k < bb.instrs.size(); ++k)
+      if (keep[k]) code.push_back(bb.instrs[k]);
+    bb.instrs.swap(code);
+  }
+  g.apply(s);
+  return count;
+}
@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////
+//
+//    ValueNumbering - Local value numbering on t-code
+//
+//    Copyright (C) 2020-2030  Universitat Politecnica de Catalunya
+//
+//    This library is free software; you can redistribute it and/or
+//    modify it under the terms of the GNU General Public License
+//    as published by the Free Software Foundation; either version 3
+//    of the License, or (at your option) any later version.
+//
+//    This library is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//    Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public
+//    License along with this library; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+//
+//    contact: Lluis Padro (padro@cs.upc.edu)
+//             Computer Science Department
+//             Universitat Politecnica de Catalunya
+//             despatx Omega.320 - Campus Nord UPC
+//             08034 Barcelona.  SPAIN
+//
+////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>    // std::size_t
+
+#include "code.h"
+
+// using namespace std;
+
+
+////////////////////////////////////////////////////////////////
+// Class ValueNumbering removes, inside every basic block, the
+// computations of a value that is already held by some operand:
+// constant loads, arithmetic, comparisons, logical operations,
+// FLOAT conversions, addresses (&a) and reads of memory (a[i], *p).
+//
+// Each operand gets a number that identifies its value; two
+// instructions with the same operation on the same numbers (in any
+// order, when the operation is commutative) compute the same value.
+// The second one becomes a copy of the operand that holds the value,
+// reads are redirected to the oldest holder, and the copies left
+// without readers are removed.
+//
+// Reads of memory are valid until the next store (a[i] = x, *p = x)
+// or call. A store also gives its value to a read of the same
+// element that follows it.
+
+class ValueNumbering {
+
+public:
+
+  // number the values of s; returns how many instructions were
+  // replaced or removed
+  static std::size_t run(subroutine &s);
+};
@@ -28,30 +28,210 @@
 
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+#include <cctype>
+// uncomment to disable assert()
+// #define NDEBUG
+#include <cassert>
 #include "code.h"
 #include "LLVMCodeGen.h"
 
 using namespace std;
 
+////////////////////////////////////////////////////////////////////
+/// Implementation for class 'operand'
+
+// intern table of the compilation unit. A deque keeps the references
+// returned by 'interned' valid while new strings are added.
+// It has no lock: while several threads generate code, each one
+// interns its texts in its own buffer (see internBuffer), and the
+// table is only read.
+namespace {
+  struct internTable {
+    deque<string> texts;
+    unordered_map<string, uint32_t> index;
+  };
+  internTable & unitTable() {
+    static internTable table;
+    return table;
+  }
+  thread_local internBuffer *currentBuffer = nullptr;
+}
+
+uint32_t operand::intern(const std::string &text) {
+  internBuffer *b = currentBuffer;
+  if (b) {
+    auto it = b->index.find(text);
+    if (it != b->index.end()) return it->second;
+    uint32_t id = LOCAL_ID | uint32_t(b->texts.size());
+    b->texts.push_back(text);
+    b->unitIds.push_back(LOCAL_ID);
+    b->index.insert(make_pair(text, id));
+    return id;
+  }
+  internTable &t = unitTable();
+  auto it = t.index.find(text);
+  if (it != t.index.end()) return it->second;
+  uint32_t id = t.texts.size();
+  assert(id < LOCAL_ID);
+  t.texts.push_back(text);
+  t.index.insert(make_pair(text, id));
+  return id;
+}
+uint32_t operand::find_interned(const std::string &text) {
+  internBuffer *b = currentBuffer;
+  if (b) {
+    auto it = b->index.find(text);
+    if (it != b->index.end()) return it->second;
+  }
+  const internTable &t = unitTable();
+  auto it = t.index.find(text);
+  return it == t.index.end() ? NOT_INTERNED : it->second;
+}
+const std::string & operand::interned(uint32_t id) {
+  if (id & LOCAL_ID) {
+    assert(currentBuffer);
+    return currentBuffer->texts[id & ~LOCAL_ID];
+  }
+  return unitTable().texts[id];
+}
+size_t operand::num_interned() {
+  return unitTable().texts.size();
+}
+
+const int operand::KIND_SHIFT;
+const uint32_t operand::ID_MASK;
+const uint32_t operand::LOCAL_ID;
+const uint32_t operand::NOT_INTERNED;
+
+/// constructors
+operand::operand() : bits(0) {}
+operand::operand(Kind k, const std::string &text) {
+  uint32_t id;
+  if (k == _NONE) id = 0;
+  else if (k == _TEMP) id = std::stoul(text.substr(1));
+  else id = intern(text);
+  bits = (uint32_t(k) << KIND_SHIFT) | (id & ID_MASK);
+}
+
+operand operand::parse(const std::string &text) {
+  if (text.empty()) return operand();
+  if (text[0] == '%' and text.size() > 1 and
+      std::all_of(text.begin()+1, text.end(), ::isdigit))
+    return operand(_TEMP, text);
+  if (std::isdigit(text[0])) {
+    if (text.find('.') != string::npos) return operand(_FLOAT, text);
+    return operand(_INT, text);
+  }
+  return operand(_VAR, text);
+}
+
+operand operand::make(Kind k, uint32_t id) {
+  operand o;
+  o.bits = (uint32_t(k) << KIND_SHIFT) | (id & ID_MASK);
+  return o;
+}
+
+operand::Kind operand::kind() const { return Kind(bits >> KIND_SHIFT); }
+uint32_t operand::id() const { return bits & ID_MASK; }
+operand operand::with_kind(Kind k) const { return make(k, id()); }
+
+bool operand::empty() const { return kind() == _NONE; }
+bool operand::is_temp() const { return kind() == _TEMP; }
+bool operand::is_name() const { return kind() == _VAR or kind() == _PARAM; }
+bool operand::is_address() const { return is_temp() or is_name(); }
+bool operand::is_literal() const { return kind() == _INT or kind() == _FLOAT or kind() == _CHAR; }
+
+bool operand::operator==(const operand &o) const { return bits == o.bits; }
+bool operand::operator!=(const operand &o) const { return bits != o.bits; }
+bool operand::operator<(const operand &o) const { return bits < o.bits; }
+
+string operand::to_string() const {
+  switch (kind()) {
+  case _NONE: return "";
+  case _TEMP: return "%" + std::to_string(id());
+  default:    return interned(id());
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////
+/// Implementation for classes 'internBuffer' and 'internScope'
+
+/// texts are added to the unit table the first time they are found,
+/// so the ids given do not depend on which thread generated what.
+/// Only ids change, so jump targets stay valid
+void internBuffer::globalize(subroutine &s) {
+  assert(currentBuffer == nullptr);
+  auto unitId = [this](uint32_t id) {
+    if (not (id & operand::LOCAL_ID)) return id;
+    uint32_t &uid = unitIds[id & ~operand::LOCAL_ID];
+    if (uid == operand::LOCAL_ID) uid = operand::intern(texts[id & ~operand::LOCAL_ID]);
+    return uid;
+  };
+  auto unit = [&unitId](operand &o) {
+    if (o.kind() != operand::_NONE and o.kind() != operand::_TEMP)
+      o = operand::make(o.kind(), unitId(o.id()));
+  };
+  for (auto &i : s.instructions) {
+    unit(i.arg1);
+    unit(i.arg2);
+    unit(i.arg3);
+  }
+  arenaMap<uint32_t, size_t> labels;
+  for (auto &l : s.labels) labels.insert(make_pair(unitId(l.first), l.second));
+  s.labels.swap(labels);
+}
+
+internScope::internScope(internBuffer &b) : previous(currentBuffer) { currentBuffer = &b; }
+internScope::~internScope() { currentBuffer = previous; }
+
+
 ////////////////////////////////////////////////////////////////////
 /// Implementation for class 'instruction'
 
+static_assert(std::is_trivially_copyable<instruction>::value,
+              "instruction must be plain data");
+
+const uint32_t instruction::NO_TARGET;
+
 /// Constructor
 instruction::instruction(Operation op,
                          const std::string &a1, const std::string &a2, const std::string &a3) {
   oper = op;
+  arg1 = operand::parse(a1);
+  arg2 = operand::parse(a2);
+  arg3 = operand::parse(a3);
+  target = NO_TARGET;
+}
+
+instruction::instruction(Operation op,
+                         const operand &a1, const operand &a2, const operand &a3) {
+  oper = op;
   arg1 = a1;
   arg2 = a2;
   arg3 = a3;
+  target = NO_TARGET;
 }
 
-instruction instruction::LABEL(const std::string &a1) { return instruction(_LABEL, a1); }
-instruction instruction::UJUMP(const std::string &a1) { return instruction(_UJUMP, a1); }
-instruction instruction::FJUMP(const std::string &a1, const std::string &a2) { return instruction(_FJUMP, a1, a2); }
-instruction instruction::HALT(const std::string &a1) { return instruction(_HALT, a1); }
+instruction instruction::LABEL(const std::string &a1) { return instruction(_LABEL, operand(operand::_LABEL, a1)); }
+instruction instruction::UJUMP(const std::string &a1) { return instruction(_UJUMP, operand(operand::_LABEL, a1)); }
+instruction instruction::FJUMP(const std::string &a1, const std::string &a2) { return instruction(_FJUMP, operand::parse(a1), operand(operand::_LABEL, a2)); }
+instruction instruction::FJLT(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FJLT, operand::parse(a1), operand::parse(a2), operand(operand::_LABEL, a3)); }
+instruction instruction::FJLE(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FJLE, operand::parse(a1), operand::parse(a2), operand(operand::_LABEL, a3)); }
+instruction instruction::FJEQ(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FJEQ, operand::parse(a1), operand::parse(a2), operand(operand::_LABEL, a3)); }
+instruction instruction::FJNE(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FJNE, operand::parse(a1), operand::parse(a2), operand(operand::_LABEL, a3)); }
+instruction instruction::FJFLT(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FJFLT, operand::parse(a1), operand::parse(a2), operand(operand::_LABEL, a3)); }
+instruction instruction::FJFLE(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FJFLE, operand::parse(a1), operand::parse(a2), operand(operand::_LABEL, a3)); }
+instruction instruction::FJFEQ(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FJFEQ, operand::parse(a1), operand::parse(a2), operand(operand::_LABEL, a3)); }
+instruction instruction::FJFNE(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_FJFNE, operand::parse(a1), operand::parse(a2), operand(operand::_LABEL, a3)); }
+instruction instruction::HALT(const std::string &a1) { return instruction(_HALT, a1.empty() ? operand() : operand(operand::_STRING, a1)); }
 instruction instruction::PUSH(const std::string &a1) { return instruction(_PUSH, a1); }
 instruction instruction::POP(const std::string &a1) { return instruction(_POP, a1); }
-instruction instruction::CALL(const std::string &a1) { return instruction(_CALL, a1); }
+instruction instruction::CALL(const std::string &a1) { return instruction(_CALL, operand(operand::_FUNC, a1)); }
 instruction instruction::RETURN() { return instruction(_RETURN); }
 instruction instruction::ADD(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_ADD, a1, a2, a3); }
 instruction instruction::SUB(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_SUB, a1, a2, a3); }
@@ -75,34 +255,43 @@ instruction instruction::FNEG(const std::string &a1, const std::string &a2) { re
 instruction instruction::FLOAT(const std::string &a1, const std::string &a2) { return instruction(_FLOAT, a1, a2); }  
 instruction instruction::LOAD(const std::string &a1, const std::string &a2) { return instruction(_LOAD, a1, a2); }
 instruction instruction::ILOAD(const std::string &a1, const std::string &a2) { return instruction(_ILOAD, a1, a2); }
-instruction instruction::CHLOAD(const std::string &a1, const std::string &a2) { return instruction(_CHLOAD, a1, a2); }
+instruction instruction::CHLOAD(const std::string &a1, const std::string &a2) { return instruction(_CHLOAD, operand::parse(a1), operand(operand::_CHAR, a2)); }
 instruction instruction::FLOAD(const std::string &a1, const std::string &a2) { return instruction(_FLOAD, a1, a2); }
 instruction instruction::XLOAD(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_XLOAD, a1, a2, a3); }
 instruction instruction::LOADX(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_LOADX, a1, a2, a3); }
 instruction instruction::ALOAD(const std::string &a1, const std::string &a2) { return instruction(_ALOAD, a1, a2); }
 instruction instruction::LOADC(const std::string &a1, const std::string &a2) { return instruction(_LOADC, a1, a2); }
 instruction instruction::CLOAD(const std::string &a1, const std::string &a2) { return instruction(_CLOAD, a1, a2); }
+instruction instruction::BCOPY(const std::string &a1, const std::string &a2, const std::string &a3) { return instruction(_BCOPY, a1, a2, a3); }
 instruction instruction::READI(const std::string &a1) { return instruction(_READI, a1); }
 instruction instruction::READF(const std::string &a1) { return instruction(_READF, a1); }
 instruction instruction::READC(const std::string &a1) { return instruction(_READC, a1); }
 instruction instruction::WRITEI(const std::string &a1) { return instruction(_WRITEI, a1); }
 instruction instruction::WRITEF(const std::string &a1) { return instruction(_WRITEF, a1); }
 instruction instruction::WRITEC(const std::string &a1) { return instruction(_WRITEC, a1); }
-instruction instruction::WRITES(const std::string &a1) { return instruction(_WRITES, a1); }
+instruction instruction::WRITES(const std::string &a1) { return instruction(_WRITES, operand(operand::_STRING, a1)); }
 instruction instruction::WRITELN() { return instruction(_WRITELN); }
 instruction instruction::NOOP() { return instruction(_NOOP); }
 
 
-/// Destructor
-instruction::~instruction() {}
-
 string instruction::dump() const {
+  string arg1 = this->arg1.to_string();
+  string arg2 = this->arg2.to_string();
+  string arg3 = this->arg3.to_string();
   string s;
   string ind="   ";
   switch (oper) {
   case instruction::_LABEL : { s = "label " + arg1 + " :"; ind = ""; break; }
   case instruction::_UJUMP : { s = "goto " + arg1; break; }
   case instruction::_FJUMP : { s = "ifFalse " + arg1 + " goto " +arg2; break; }
+  case instruction::_FJLT : { s = "ifFalse " + arg1 + " < " + arg2 + " goto " + arg3; break; }
+  case instruction::_FJLE : { s = "ifFalse " + arg1 + " <= " + arg2 + " goto " + arg3; break; }
+  case instruction::_FJEQ : { s = "ifFalse " + arg1 + " == " + arg2 + " goto " + arg3; break; }
+  case instruction::_FJNE : { s = "ifFalse " + arg1 + " != " + arg2 + " goto " + arg3; break; }
+  case instruction::_FJFLT : { s = "ifFalse " + arg1 + " <. " + arg2 + " goto " + arg3; break; }
+  case instruction::_FJFLE : { s = "ifFalse " + arg1 + " <=. " + arg2 + " goto " + arg3; break; }
+  case instruction::_FJFEQ : { s = "ifFalse " + arg1 + " ==. " + arg2 + " goto " + arg3; break; }
+  case instruction::_FJFNE : { s = "ifFalse " + arg1 + " !=. " + arg2 + " goto " + arg3; break; }
   case instruction::_HALT  : { s = "halt \"" + arg1 + "\""; break; }
   case instruction::_LOAD  : 
   case instruction::_FLOAD : 
@@ -117,6 +306,7 @@ string instruction::dump() const {
   case instruction::_ALOAD : { s = arg1 + " = &" + arg2; break; }
   case instruction::_LOADC : { s = arg1 + " = *" + arg2; break; }
   case instruction::_CLOAD : { s = "*" + arg1 + " = " + arg2; break; }
+  case instruction::_BCOPY : { s = "bcopy " + arg1 + " " + arg2 + " " + arg3; break; }
   case instruction::_READI : { s = "readi " + arg1; break; }
   case instruction::_READF : { s = "readf " + arg1; break; }
   case instruction::_READC : { s = "readc " + arg1; break; }
@@ -152,6 +342,129 @@ string instruction::dump() const {
   return ind + s;
 }
 
+////////////////////////////////////////////////////////////////////
+// def/use information
+
+// true if arg1 is written by the operation
+static bool defines_arg1(instruction::Operation op) {
+  switch (op) {
+  case instruction::_ADD: case instruction::_SUB: case instruction::_MUL: case instruction::_DIV:
+  case instruction::_EQ: case instruction::_LT: case instruction::_LE:
+  case instruction::_NEG: case instruction::_NOT: case instruction::_AND: case instruction::_OR:
+  case instruction::_FLOAT: case instruction::_FADD: case instruction::_FSUB: case instruction::_FMUL:
+  case instruction::_FDIV: case instruction::_FEQ: case instruction::_FLT: case instruction::_FLE:
+  case instruction::_FNEG: case instruction::_LOAD: case instruction::_ILOAD: case instruction::_CHLOAD:
+  case instruction::_FLOAD: case instruction::_LOADX: case instruction::_ALOAD: case instruction::_LOADC:
+  case instruction::_READI: case instruction::_READF: case instruction::_READC: case instruction::_POP:
+    return true;
+  default:
+    return false;
+  }
+}
+
+operand instruction::def() const {
+  if (defines_arg1(oper) and arg1.is_address()) return arg1;
+  return operand();
+}
+
+int instruction::uses(operand (&u)[3]) const {
+  int n = 0;
+  if (not defines_arg1(oper) and arg1.is_address()) u[n++] = arg1;
+  if (arg2.is_address()) u[n++] = arg2;
+  if (arg3.is_address()) u[n++] = arg3;
+  return n;
+}
+
+int instruction::use_slots(operand *(&u)[3]) {
+  int n = 0;
+  if (not defines_arg1(oper) and arg1.is_address()) u[n++] = &arg1;
+  if (arg2.is_address()) u[n++] = &arg2;
+  if (arg3.is_address()) u[n++] = &arg3;
+  return n;
+}
+
+bool instruction::has_side_effects() const {
+  switch (oper) {
+  case instruction::_ADD: case instruction::_SUB: case instruction::_MUL:
+  case instruction::_EQ: case instruction::_LT: case instruction::_LE:
+  case instruction::_NEG: case instruction::_NOT: case instruction::_AND: case instruction::_OR:
+  case instruction::_FLOAT: case instruction::_FADD: case instruction::_FSUB: case instruction::_FMUL:
+  case instruction::_FDIV: case instruction::_FEQ: case instruction::_FLT: case instruction::_FLE:
+  case instruction::_FNEG: case instruction::_LOAD: case instruction::_ILOAD: case instruction::_CHLOAD:
+  case instruction::_FLOAD: case instruction::_LOADX: case instruction::_ALOAD: case instruction::_LOADC:
+  case instruction::_NOOP:
+    return false;
+  default:
+    return true;
+  }
+}
+
+bool instruction::is_copy() const {
+  return (oper == instruction::_LOAD or oper == instruction::_ILOAD or
+          oper == instruction::_FLOAD or oper == instruction::_CHLOAD) and
+         arg1.is_address() and arg2.is_address();
+}
+
+bool instruction::is_address_slot(const operand *slot) const {
+  switch (oper) {
+  case instruction::_LOADX: return slot == &arg2;
+  case instruction::_XLOAD: return slot == &arg1;
+  case instruction::_LOADC: return slot == &arg2;
+  case instruction::_CLOAD: return slot == &arg1;
+  case instruction::_BCOPY: return slot == &arg1 or slot == &arg2;
+  default:                  return false;
+  }
+}
+
+bool instruction::never_falls_through() const {
+  return oper == instruction::_UJUMP or oper == instruction::_RETURN or oper == instruction::_HALT;
+}
+
+bool instruction::is_jump() const {
+  return oper == instruction::_UJUMP or is_cond_jump();
+}
+
+bool instruction::is_cond_jump() const {
+  bool negated;
+  return oper == instruction::_FJUMP or branch_relation(oper, negated) != instruction::_INVALID;
+}
+
+const operand & instruction::jump_label() const {
+  if (oper == instruction::_UJUMP) return arg1;
+  if (oper == instruction::_FJUMP) return arg2;
+  return arg3;
+}
+
+operand & instruction::jump_label() {
+  return const_cast<operand &>(static_cast<const instruction *>(this)->jump_label());
+}
+
+instruction::Operation instruction::branch_relation(Operation op, bool &negated) {
+  negated = (op == instruction::_FJNE or op == instruction::_FJFNE);
+  switch (op) {
+  case instruction::_FJLT:  return instruction::_LT;
+  case instruction::_FJLE:  return instruction::_LE;
+  case instruction::_FJEQ:  case instruction::_FJNE:  return instruction::_EQ;
+  case instruction::_FJFLT: return instruction::_FLT;
+  case instruction::_FJFLE: return instruction::_FLE;
+  case instruction::_FJFEQ: case instruction::_FJFNE: return instruction::_FEQ;
+  default:                  return instruction::_INVALID;
+  }
+}
+
+instruction::Operation instruction::branch_on(Operation rel, bool negated) {
+  switch (rel) {
+  case instruction::_EQ:  return negated ? instruction::_FJNE : instruction::_FJEQ;
+  case instruction::_FEQ: return negated ? instruction::_FJFNE : instruction::_FJFEQ;
+  case instruction::_LT:  return negated ? instruction::_INVALID : instruction::_FJLT;
+  case instruction::_LE:  return negated ? instruction::_INVALID : instruction::_FJLE;
+  case instruction::_FLT: return negated ? instruction::_INVALID : instruction::_FJFLT;
+  case instruction::_FLE: return negated ? instruction::_INVALID : instruction::_FJFLE;
+  default:                return instruction::_INVALID;
+  }
+}
+
+
 ////////////////////////////////////////////////////////////////////
 // concatenation of instruction+list (or instruction+instruction, via automatic coertion)
 
@@ -163,24 +476,82 @@ instructionList instruction::operator||(const instructionList &lst) const {
 ////////////////////////////////////////////////////////////////////
 /// Implementation for class 'instructionList'
 
+// node of the rope: a leaf holds one instruction, an inner chunk
+// joins two non-empty lists (left goes before right)
+class instructionList::chunk {
+public:
+  chunk(const instruction &i) : leaf(true), inst(i) {}
+  chunk(const std::shared_ptr<chunk> &l, const std::shared_ptr<chunk> &r)
+    : leaf(false), inst(instruction::_INVALID), left(l), right(r) {}
+  ~chunk();
+
+  bool leaf;
+  instruction inst;
+  std::shared_ptr<chunk> left, right;
+};
+
+// release the children iteratively: the rope built by a chain of
+// 'code = code || X' is as deep as the list is long, and a recursive
+// destruction would overflow the stack on big functions
+instructionList::chunk::~chunk() {
+  vector<shared_ptr<chunk>> pending;
+  if (left)  pending.push_back(std::move(left));
+  if (right) pending.push_back(std::move(right));
+  while (not pending.empty()) {
+    shared_ptr<chunk> c = std::move(pending.back());
+    pending.pop_back();
+    if (c.use_count() == 1) {
+      if (c->left)  pending.push_back(std::move(c->left));
+      if (c->right) pending.push_back(std::move(c->right));
+    }
+  }
+}
+
 // constructor
-instructionList::instructionList() {}
+instructionList::instructionList() : length(0) {}
 // constructor from a single instruction
-instructionList::instructionList(const instruction &inst) { this->push_back(inst); }
+instructionList::instructionList(const instruction &inst)
+  : root(allocate_shared<chunk>(arenaAllocator<chunk>(), inst)), length(1) {}
 // destructor
 instructionList::~instructionList() {}
 
 // concatenation of lists (or list+instruction, via automatic coertion)
 instructionList instructionList::operator||(const instructionList &lst) const {
-  instructionList newlist = (*this);
-  newlist.insert(newlist.end(), lst.begin(), lst.end());
+  if (lst.empty()) return *this;
+  if (empty()) return lst;
+  instructionList newlist;
+  newlist.root = allocate_shared<chunk>(arenaAllocator<chunk>(), root, lst.root);
+  newlist.length = length + lst.length;
   return newlist;
 }
 
+// number of instructions in the list
+size_t instructionList::size() const { return length; }
+// true if the list has no instructions
+bool instructionList::empty() const { return length == 0; }
+
+// append the instructions of the list, in order, at the end of v
+void instructionList::flatten(arenaVector<instruction> &v) const {
+  v.reserve(v.size() + length);
+  vector<const chunk *> pending;
+  if (root) pending.push_back(root.get());
+  while (not pending.empty()) {
+    const chunk *c = pending.back();
+    pending.pop_back();
+    if (c->leaf) v.push_back(c->inst);
+    else {
+      pending.push_back(c->right.get());
+      pending.push_back(c->left.get());
+    }
+  }
+}
+
 // print instructionList (for debugging)
 string instructionList::dump() const {
-  string s;  
-  for (auto i : *this ) s += i.dump() + "\n";
+  arenaVector<instruction> v;
+  flatten(v);
+  string s;
+  for (auto &i : v) s += i.dump() + "\n";
   return s;
 }
 
@@ -198,6 +569,13 @@ var::var(const std::string &n, const std::string &t, size_t ne) {
 /// destructor
 var::~var() {}
 
+/// true if the type ends in " array"
+bool var::is_array() const {
+  const string suffix = " array";
+  return type.size() >= suffix.size() and
+         type.compare(type.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
 /// print (for debugging)
 string var::dump() const {
   
@@ -215,11 +593,11 @@ string var::dump() const {
 /// Implementation for class 'subroutine'
 
 /// constructor
-subroutine::subroutine(const string &sname) { name = sname; }
+subroutine::subroutine(const string &sname) : resolved(true) { name = sname; }
 /// destructor
 subroutine::~subroutine() {}
 /// get subroutine name
-string subroutine::get_name() const { return name; };
+const string & subroutine::get_name() const { return name; }
 /// add new variable
 void subroutine::add_var(const var &v) { vars.push_back(v); }
 /// add new variable
@@ -231,29 +609,98 @@ void subroutine::add_param(const std::string &name, const std::string &type, boo
 }
 /// add new instruction
 void subroutine::add_instruction(const instruction &inst) {
-  if (inst.oper == instruction::_LABEL) labels.insert(make_pair(inst.arg1,instructions.size()));
   instructions.push_back(inst);
+  resolved = false;
+  bind_instruction(instructions.size()-1, param_ids());
 }
-/// add instruction list to current instructions
+/// add instruction list to current instructions (the list is flattened here)
 void subroutine::add_instructions(const instructionList &lins) {
-  for (auto i : lins)
-    this->add_instruction(i);
+  size_t first = instructions.size();
+  lins.flatten(instructions);
+  resolved = false;
+  std::vector<uint32_t> pids = param_ids();
+  for (size_t pc = first; pc < instructions.size(); ++pc)
+    bind_instruction(pc, pids);
+}
+/// interned names of the parameters
+std::vector<uint32_t> subroutine::param_ids() const {
+  std::vector<uint32_t> pids;
+  for (auto &p : params) pids.push_back(operand::intern(p.name));
+  return pids;
+}
+/// register the label (if any) of the instruction at pc, and tell
+/// parameters from local variables in its operands
+void subroutine::bind_instruction(size_t pc, const std::vector<uint32_t> &pids) {
+  instruction &inst = instructions[pc];
+  if (inst.oper == instruction::_LABEL) labels.insert(make_pair(inst.arg1.id(), pc));
+  for (operand *a : {&inst.arg1, &inst.arg2, &inst.arg3}) {
+    if (a->kind() == operand::_VAR and
+        std::find(pids.begin(), pids.end(), a->id()) != pids.end())
+      *a = a->with_kind(operand::_PARAM);
+  }
 }
-/// set instruction list (overwritting current instructions)
+/// set instruction list (overwritting current instructions and labels)
 void subroutine::set_instructions(const instructionList &lins) {
   instructions.clear();
+  labels.clear();
   this->add_instructions(lins);
+  // the code generator and the passes never leave a jump without its
+  // label (code read from elsewhere is checked with resolve_labels)
+  string badLabel;
+  bool resolvedAll = resolve_labels(badLabel);
+  assert(resolvedAll and "label undefined or defined twice");
+  (void) resolvedAll;
 }
+/// store in every jump the position of its target label
+bool subroutine::resolve_labels(std::string &badLabel) {
+  for (auto &inst : instructions) {
+    // a label defined twice is registered only at its first position
+    if (inst.oper == instruction::_LABEL and
+        labels.find(inst.arg1.id())->second != size_t(&inst - instructions.data())) {
+      badLabel = inst.arg1.to_string();
+      return false;
+    }
+    if (not inst.is_jump()) continue;
+    const operand &lab = inst.jump_label();
+    auto it = labels.find(lab.id());
+    if (it == labels.end()) {
+      badLabel = lab.to_string();
+      return false;
+    }
+    inst.target = it->second;
+  }
+  resolved = true;
+  return true;
+}
+/// true if all jump targets are resolved
+bool subroutine::labels_resolved() const { return resolved; }
 /// get instruction at given program counter
-instruction subroutine::get_instruction_at(size_t pc) const {
-  if (pc>=instructions.size()) return instruction(instruction::_INVALID);
+const instruction & subroutine::get_instruction_at(size_t pc) const {
+  static const instruction invalid(instruction::_INVALID);
+  if (pc>=instructions.size()) return invalid;
   return instructions[pc];
 }
 /// get program counter for given label
-size_t subroutine::get_label_pc(std::string &lab) const { return labels.find(lab)->second; }
-/// get the list of instructions (needed only in LLVMCodeGen)
-instructionList subroutine::get_instructions() const {
-  return instructions;
+size_t subroutine::get_label_pc(const std::string &lab) const {
+  auto it = labels.find(operand::find_interned(lab));
+  assert(it != labels.end());
+  return it->second;
+}
+/// get program counter of the target of the jump at given pc
+size_t subroutine::get_jump_target(size_t pc) const { return instructions[pc].target; }
+/// get the list of instructions (a view, no copy is made)
+constSpan<instruction> subroutine::get_instructions() const {
+  return constSpan<instruction>(instructions);
+}
+/// number of instructions
+size_t subroutine::get_num_instructions() const { return instructions.size(); }
+/// highest temporal number used by the instructions
+uint32_t subroutine::max_temp() const {
+  uint32_t m = 0;
+  for (const instruction &i : instructions)
+    for (const operand *a : {&i.arg1, &i.arg2, &i.arg3})
+      if (a->is_temp()) m = max(m, a->id());
+  return m;
 }
 /// print (for debugging)
 string subroutine::dump() const {
@@ -261,18 +708,18 @@ string subroutine::dump() const {
   s = "function " + name + "\n";
   if (not params.empty()) {
     s += "  params\n" ;
-    for (auto p : params) s += "    " + p.dump() + "\n";
+    for (const auto &p : params) s += "    " + p.dump() + "\n";
     s += "  endparams\n\n";
   }
   if (not vars.empty()) {
     s += "  vars\n";
-    for (auto v : vars) s += "    " + v.dump() + "\n";
+    for (const auto &v : vars) s += "    " + v.dump() + "\n";
     s += "  endvars\n\n";
   }
 
   string ind = "  ";
   if (labels.empty()) ind="";
-  for (auto i : instructions) s += ind + i.dump() + "\n";  
+  for (const auto &i : instructions) s += ind + i.dump() + "\n";
   s += "endfunction\n\n";
   return s;
 }
@@ -303,13 +750,27 @@ void code::add_subroutine(const subroutine &s) {
   names.insert(make_pair(s.get_name(), subs.size()-1));
 }
 /// get the list of subroutine's (needed only in LLVMCodeGen)
-const std::vector<subroutine> & code::get_subroutine_list() const {
-  return subs;
+constSpan<subroutine> code::get_subroutine_list() const {
+  return constSpan<subroutine>(subs);
+}
+/// get subroutine by position in the list
+subroutine& code::get_subroutine_at(size_t i) { return subs[i]; }
+/// remove subroutines (the others keep their order)
+void code::remove_subroutines(const vector<bool> &keep) {
+  size_t n = 0;
+  for (size_t i = 0; i < subs.size(); ++i)
+    if (keep[i]) {
+      if (n != i) subs[n] = subs[i];
+      ++n;
+    }
+  subs.erase(subs.begin() + n, subs.end());
+  names.clear();
+  for (size_t i = 0; i < subs.size(); ++i) names.insert(make_pair(subs[i].get_name(), i));
 }
 /// print (for debugging)
 string code::dump() const {
   string c;
-  for (auto s : subs) c += s.dump();
+  for (const auto &s : subs) c += s.dump();
   return c;
 }
 /// print the code in LLVM IR
@@ -321,18 +782,18 @@ std::string code::dumpLLVM(const TypesMgr & Types, const SymTable & Symbols) con
 
 
 ////////////////////////////////////////////////////////////////////
-/// Static methods to manage counters
-int counters::countIF = 0;
-int counters::countWHILE = 0;
-int counters::countTEMP = 0;
+/// Methods to manage counters
+counters::counters() : countIF(0), countWHILE(0), countCOND(0), countTEMP(0) {}
 
 string counters::newLabelIF() { return std::to_string(++countIF); }
 string counters::newLabelWHILE() { return std::to_string(++countWHILE); }
+string counters::newLabelCOND() { return std::to_string(++countCOND); }
 string counters::newTEMP() { return std::to_string(++countTEMP); }
 
 void counters::resetLabelIF() { countIF = 0; }
 void counters::resetLabelWHILE() { countWHILE = 0; }
+void counters::resetLabelCOND() { countCOND = 0; }
 void counters::resetTEMP() { countTEMP = 0; }
 
-void counters::resetLabels() { resetLabelIF(); resetLabelWHILE(); }
+void counters::resetLabels() { resetLabelIF(); resetLabelWHILE(); resetLabelCOND(); }
 void counters::reset() { resetLabels(); resetTEMP(); }
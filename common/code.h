@@ -30,15 +30,137 @@
 
 #include <map>
 #include <list>
+#include <deque>
 #include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
 #include "TypesMgr.h"
 #include "SymTable.h"
+#include "Arena.h"
 
 
 /// predeclaration
 class instructionList;
+class subroutine;
 class LLVMCodeGen;
 
+/// containers of the generated code take their memory from the arena
+/// of the compilation unit (see Arena.h)
+template <class T>
+using arenaVector = std::vector<T, arenaAllocator<T>>;
+template <class T>
+using arenaList = std::list<T, arenaAllocator<T>>;
+template <class K, class V>
+using arenaMap = std::map<K, V, std::less<K>, arenaAllocator<std::pair<const K, V>>>;
+
+////////////////////////////////////////////////////////////////////
+/// Class operand stores an argument of an instruction as a tagged id.
+/// Temporals keep their number as id; names, labels and literals are
+/// interned in a string table shared by the whole compilation unit
+/// (one asl run). Operands are 4 bytes, trivially copyable, and their
+/// text is only rebuilt when the code is printed.
+
+class operand {
+public:
+  /// operand kinds
+  typedef enum {_NONE, _TEMP, _VAR, _PARAM, _INT, _FLOAT, _CHAR,
+                _LABEL, _FUNC, _STRING} Kind;
+
+  /// constructor of an empty operand
+  operand();
+  /// constructor of an operand of given kind (text is interned, except for temporals)
+  operand(Kind k, const std::string &text);
+  /// operand deduced from its text: "" empty, "%N" temporal,
+  /// "N" or "N.M" number literal, anything else a variable name
+  static operand parse(const std::string &text);
+  /// operand of given kind with an already known id (temporal number
+  /// or index in the intern table)
+  static operand make(Kind k, uint32_t id);
+
+  /// kind and id of the operand
+  Kind kind() const;
+  uint32_t id() const;
+  /// same operand (same id) with another kind
+  operand with_kind(Kind k) const;
+
+  /// some useful classifications
+  bool empty() const;
+  bool is_temp() const;     // %N
+  bool is_name() const;     // local var or parameter
+  bool is_address() const;  // temporal, local var or parameter
+  bool is_literal() const;  // int, float or char constant
+
+  /// comparison (same kind and same id)
+  bool operator==(const operand &o) const;
+  bool operator!=(const operand &o) const;
+  bool operator<(const operand &o) const;
+
+  /// text of the operand, as it is written in t-code
+  std::string to_string() const;
+
+  /// access to the intern table of the compilation unit (or to the
+  /// buffer of the calling thread, see internBuffer)
+  static uint32_t intern(const std::string &text);
+  /// id of an interned text, without adding it (NOT_INTERNED if absent)
+  static uint32_t find_interned(const std::string &text);
+  static const std::string & interned(uint32_t id);
+  static std::size_t num_interned();
+
+  /// kind in the 4 high bits, id in the low ones
+  static const int KIND_SHIFT = 28;
+  static const uint32_t ID_MASK = (1u << KIND_SHIFT) - 1;
+  /// ids of texts interned in the buffer of a thread have this bit
+  static const uint32_t LOCAL_ID = 1u << (KIND_SHIFT - 1);
+  /// id returned by find_interned for texts not in the table
+  static const uint32_t NOT_INTERNED = UINT32_MAX;
+
+private:
+  uint32_t bits;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class internBuffer keeps the texts interned by a thread that
+/// generates code at the same time as others (see internScope).
+/// While buffers are in use, the table of the compilation unit is
+/// only read, so no thread needs a lock: every text gets an id of
+/// the buffer of the thread (with operand::LOCAL_ID). When the
+/// threads are done, globalize() gives the operands of their code
+/// the ids of the unit table.
+
+class internBuffer {
+public:
+  internBuffer() = default;
+  internBuffer(const internBuffer &) = delete;
+  internBuffer & operator=(const internBuffer &) = delete;
+
+  /// replace the ids of this buffer in the operands of s by ids of
+  /// the unit table. No buffer may be in use in any thread.
+  void globalize(subroutine &s);
+
+private:
+  friend class operand;
+  std::deque<std::string> texts;
+  std::unordered_map<std::string, uint32_t> index;
+  std::vector<uint32_t> unitIds;    // id in the unit table (or LOCAL_ID)
+};
+
+/// Class internScope makes a buffer the one of the calling thread
+/// while the scope object is alive.
+
+class internScope {
+public:
+  explicit internScope(internBuffer &b);
+  ~internScope();
+  internScope(const internScope &) = delete;
+  internScope & operator=(const internScope &) = delete;
+private:
+  internBuffer *previous;
+};
+
+
 ////////////////////////////////////////////////////////////////////
 /// Class instruction stores a VM instruction code with its operands
 
@@ -48,24 +170,83 @@ public:
   typedef enum {_LABEL, _UJUMP, _FJUMP, _HALT, _PUSH, _POP, _CALL, _RETURN,
                 _ADD, _SUB, _MUL, _DIV, _EQ, _LT, _LE, _NEG, _NOT, _AND, _OR, _FLOAT,
                 _FADD, _FSUB, _FMUL, _FDIV, _FEQ, _FLT, _FLE, _FNEG,
-                _LOAD, _ILOAD, _CHLOAD, _FLOAD, _XLOAD, _LOADX, _ALOAD, _LOADC, _CLOAD,
-                _READI, _READF, _READC, _WRITEI, _WRITEF, _WRITEC, _WRITES, _WRITELN, _NOOP, _INVALID} Operation;
+                _LOAD, _ILOAD, _CHLOAD, _FLOAD, _XLOAD, _LOADX, _ALOAD, _LOADC, _CLOAD, _BCOPY,
+                _READI, _READF, _READC, _WRITEI, _WRITEF, _WRITEC, _WRITES, _WRITELN,
+                _FJLT, _FJLE, _FJEQ, _FJNE, _FJFLT, _FJFLE, _FJFEQ, _FJFNE, _NOOP, _INVALID} Operation;
   
   /// instruction code
   Operation oper;
   /// arguments
-  std::string arg1, arg2, arg3;
+  operand arg1, arg2, arg3;
+  /// for the jumps (see is_jump), position of the target label in the
+  /// subroutine, once labels have been resolved (NO_TARGET otherwise)
+  uint32_t target;
+  static const uint32_t NO_TARGET = UINT32_MAX;
   
-  /// constructor
+  /// constructor (operands are deduced from their text, see operand::parse)
   instruction(Operation op,
               const std::string &a1="", const std::string &a2="", const std::string &a3="");
+  /// constructor from already built operands
+  instruction(Operation op,
+              const operand &a1, const operand &a2=operand(), const operand &a3=operand());
 
-  /// destructor
-  ~instruction();
+  /// copy, move and destruction are trivial (instructions are plain data)
+  instruction(const instruction &) = default;
+  instruction(instruction &&) = default;
+  instruction & operator=(const instruction &) = default;
+  instruction & operator=(instruction &&) = default;
+  ~instruction() = default;
 
   // concatenation of instruction+list (or instruction+instruction, via automatic coertion)
   instructionList operator||(const instructionList &lst) const;
 
+  /// ------ def/use information, shared by all the analyses -------
+
+  // operand written by the instruction (empty if it writes none).
+  // Stores through an address (a[i] = x, *p = x) write memory, not an operand
+  operand def() const;
+  // operands read by the instruction (temporals, local vars and
+  // params, never literals or labels). Returns how many are in u
+  int uses(operand (&u)[3]) const;
+  // same, but giving the slots themselves, so that passes can rewrite them
+  int use_slots(operand *(&u)[3]);
+  // true if removing the instruction could change the behaviour of
+  // the program even if def() is never read: control flow, calls,
+  // parameter passing, I/O, stores, and integer division (it may trap)
+  bool has_side_effects() const;
+  // true if the instruction copies an address operand into another
+  // one ("x = y", or the "%t = x" of an unary plus), even "x = x"
+  bool is_copy() const;
+  // true if the given slot (&arg1, &arg2 or &arg3) holds an address
+  // of memory: the base of an indexed access, or a pointer. A param
+  // cannot be used there (the VM needs it in a temporal)
+  bool is_address_slot(const operand *slot) const;
+
+  /// ------ jumps -------
+
+  // true for goto, return and halt: the instruction ends its basic
+  // block and never goes on to the next one
+  bool never_falls_through() const;
+
+  // true for goto, ifFalse and the compare-and-branch instructions
+  bool is_jump() const;
+  // true for the jumps that may fall through (ifFalse and the
+  // compare-and-branch instructions)
+  bool is_cond_jump() const;
+  // label where a jump goes: arg1 of goto, arg2 of ifFalse and arg3
+  // of a compare-and-branch
+  const operand & jump_label() const;
+  operand & jump_label();
+  // comparison tested by the compare-and-branch op: "ifFalse a < b
+  // goto L" jumps when a < b (_LT) is false. The != forms test _EQ
+  // or _FEQ, with negated set. _INVALID if op is not one of them
+  static Operation branch_relation(Operation op, bool &negated);
+  // the compare-and-branch that jumps when the comparison rel (_EQ,
+  // _LT, _LE, _FEQ, _FLT or _FLE), or its negation if negated, is
+  // false; _INVALID if there is none (< and <= have no negated form:
+  // for integers, swap the operands instead)
+  static Operation branch_on(Operation rel, bool negated);
+
   /// ------ specific constructors for each instruction -------
 
   // create new instruction "a1 :"
@@ -74,6 +255,22 @@ public:
   static instruction UJUMP(const std::string &a1);
   // create new instruction "ifFalse a1 goto a2"
   static instruction FJUMP(const std::string &a1, const std::string &a2);
+  // create new instruction "ifFalse a1 < a2 goto a3"
+  static instruction FJLT(const std::string &a1, const std::string &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 <= a2 goto a3"
+  static instruction FJLE(const std::string &a1, const std::string &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 == a2 goto a3"
+  static instruction FJEQ(const std::string &a1, const std::string &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 != a2 goto a3"
+  static instruction FJNE(const std::string &a1, const std::string &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 <. a2 goto a3"
+  static instruction FJFLT(const std::string &a1, const std::string &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 <=. a2 goto a3"
+  static instruction FJFLE(const std::string &a1, const std::string &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 ==. a2 goto a3"
+  static instruction FJFEQ(const std::string &a1, const std::string &a2, const std::string &a3);
+  // create new instruction "ifFalse a1 !=. a2 goto a3"
+  static instruction FJFNE(const std::string &a1, const std::string &a2, const std::string &a3);
   // create new instruction "halt"
   static instruction HALT(const std::string &a1="");
   // create new instruction "pushparam a1"
@@ -142,6 +339,9 @@ public:
   static instruction LOADC(const std::string &a1, const std::string &a2);
   // create new instruction "*a1 = a2" 
   static instruction CLOAD(const std::string &a1, const std::string &a2);
+  // create new instruction "bcopy a1 a2 a3" (copy the first a3
+  // elements of array a2 into array a1; a3 is an integer constant)
+  static instruction BCOPY(const std::string &a1, const std::string &a2, const std::string &a3);
   // create new instruction "readi a1" 
   static instruction READI(const std::string &a1);
   // create new instruction "readf a1" 
@@ -167,22 +367,74 @@ public:
 
 
 ////////////////////////////////////////////////////////////////////
-/// Class instructionList stores a list of instructions
+/// Template constSpan<T> is a read-only view of a contiguous sequence
+/// owned by somebody else (e.g. the instructions of a subroutine).
+/// It is cheap to copy and lets callers iterate without copying the
+/// sequence. It is valid while the owner is not modified.
+
+template <class T>
+class constSpan {
+public:
+  typedef const T * iterator;
+
+  constSpan() : first(nullptr), count(0) {}
+  constSpan(const T *p, std::size_t n) : first(p), count(n) {}
+  template <class Alloc>
+  constSpan(const std::vector<T, Alloc> &v) : first(v.data()), count(v.size()) {}
+
+  iterator begin() const { return first; }
+  iterator end() const { return first + count; }
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  const T & operator[](std::size_t i) const { return first[i]; }
+  const T & front() const { return first[0]; }
+  const T & back() const { return first[count-1]; }
+
+private:
+  const T *first;
+  std::size_t count;
+};
+
+
+////////////////////////////////////////////////////////////////////
+/// Class instructionList stores a sequence of instructions while the
+/// code is being generated. It is a rope of immutable, shared chunks:
+/// copying a list or concatenating two lists with || is O(1), no
+/// matter how long they are. The sequence is flattened only once,
+/// when it is stored into a subroutine.
 
-class instructionList : public std::vector<instruction> {
+class instructionList {
 public:
   // constructor
   instructionList();
   // constructor from a single instruction
   instructionList(const instruction &);
+  // copy and move (both O(1), chunks are shared)
+  instructionList(const instructionList &) = default;
+  instructionList(instructionList &&) = default;
+  instructionList & operator=(const instructionList &) = default;
+  instructionList & operator=(instructionList &&) = default;
   // destructor
   ~instructionList();
 
   // concatenation of lists (or list+instruction, via automatic coertion)
   instructionList operator||(const instructionList &lst) const;
 
+  // number of instructions in the list
+  std::size_t size() const;
+  // true if the list has no instructions
+  bool empty() const;
+  // append the instructions of the list, in order, at the end of v
+  void flatten(arenaVector<instruction> &v) const;
+
   // print instructionList
-  std::string dump() const;   
+  std::string dump() const;
+
+private:
+  // node of the rope: either a single instruction or the join of two lists
+  class chunk;
+  std::shared_ptr<chunk> root;
+  std::size_t length;
 };
 
 
@@ -198,6 +450,10 @@ public:
   var(const std::string &name, const std::string &type, size_t nelem=1);
   ~var();
 
+  // true if the type ends in " array": the params passed by reference
+  // (see subroutine::add_param; local arrays keep the element type)
+  bool is_array() const;
+
   // print var
   std::string dump() const; 
 };
@@ -211,23 +467,32 @@ class subroutine {
 private:
   /// name of the subroutine
   std::string name;
-  /// instructions
-  instructionList instructions;
-  /// map label name -> position in instructions
-  std::map<std::string, size_t> labels;
+  /// instructions (already flattened)
+  arenaVector<instruction> instructions;
+  /// map label (interned id) -> position in instructions
+  arenaMap<uint32_t, size_t> labels;
+  /// true if the targets of all jumps are up to date
+  bool resolved;
+
+  /// interned names of the parameters
+  std::vector<uint32_t> param_ids() const;
+  /// register labels and bind parameter operands of instruction at pc
+  void bind_instruction(size_t pc, const std::vector<uint32_t> &pids);
+  /// renames the operands in place when threads are merged
+  friend class internBuffer;
 
 public:
   /// list of local variables
-  std::list<var> vars;
+  arenaList<var> vars;
   /// list of params
-  std::list<var> params;  
+  arenaList<var> params;  
 
   /// constructor and destructor
   subroutine(const std::string &sname);
   ~subroutine();
 
   /// get subroutine name
-  std::string get_name() const;
+  const std::string & get_name() const;
   /// add a local var to subroutine
   void add_var(const var &v);
   /// add a local var to subroutine
@@ -238,15 +503,31 @@ public:
   void add_instruction(const instruction &inst);
   /// add instruction list to current instructions
   void add_instructions(const instructionList &lins);
-  /// set instruction list (overwritting current instructions)
+  /// set instruction list (overwritting current instructions and labels).
+  /// The subroutine is finished: jump targets are resolved (see
+  /// resolve_labels). Every jump must have its label (asserted)
   void set_instructions(const instructionList &lins);
+  /// store in every jump the position of its target label. Returns
+  /// false (and the offending label) if some target is not defined,
+  /// or some label is defined twice
+  bool resolve_labels(std::string &badLabel);
+  /// true if all jump targets are resolved
+  bool labels_resolved() const;
   
   /// get instruction at given program counter in subroutine
-  instruction get_instruction_at(size_t pc) const;
+  /// (an _INVALID instruction if pc is out of range)
+  const instruction & get_instruction_at(size_t pc) const;
   /// get program counter in subroutine for given label
-  size_t get_label_pc(std::string &lab) const;
-  /// get the list of instructions (needed only in LLVMCodeGen)
-  instructionList get_instructions() const;
+  size_t get_label_pc(const std::string &lab) const;
+  /// get program counter of the target of the jump at given pc
+  /// (labels must be resolved)
+  size_t get_jump_target(size_t pc) const;
+  /// get the list of instructions (a view, no copy is made)
+  constSpan<instruction> get_instructions() const;
+  /// number of instructions
+  size_t get_num_instructions() const;
+  /// highest temporal number used by the instructions (0 if none)
+  uint32_t max_temp() const;
 
   // print subroutine (params, vars, and instructions)
   std::string dump() const;
@@ -259,9 +540,9 @@ public:
 class code {
 private:
   /// subroutines (including main progam)
-  std::vector<subroutine> subs;
+  arenaVector<subroutine> subs;
   /// index to access subroutines by name
-  std::map<std::string, size_t> names;
+  arenaMap<std::string, size_t> names;
   
 public:
   /// constructor and destructor
@@ -274,8 +555,12 @@ public:
   const subroutine& get_subroutine(const std::string &name) const;
   /// add new subroutine
   void add_subroutine(const subroutine &s);
-  /// get the list of subroutines (needed only in LLVMCodeGen)
-  const std::vector<subroutine> & get_subroutine_list() const;
+  /// get the list of subroutines (a view, no copy is made)
+  constSpan<subroutine> get_subroutine_list() const;
+  /// get subroutine by position in the list (to be modified by a pass)
+  subroutine& get_subroutine_at(size_t i);
+  /// remove the subroutines whose position is not marked in 'keep'
+  void remove_subroutines(const std::vector<bool> &keep);
 
   // print code (all info for all subroutines)
   std::string dump() const;
@@ -291,28 +576,36 @@ public:
 
 
 ////////////////////////////////////////////////////////////////////
-/// Class counters manages temporal and labels counters
+/// Class counters manages temporal and labels counters. Each code
+/// generator has its own counters, so functions can be generated
+/// by different threads at the same time.
 
 class counters {
 private:
-  static int countIF;
-  static int countWHILE;
-  static int countTEMP;
+  int countIF;
+  int countWHILE;
+  int countCOND;
+  int countTEMP;
 
 public:
+  // constructor (all counters start at 0)
+  counters();
+
   // return id for new label or temp (id is a number, but returned as string
   // to ease concatenation with other literals (e.g. "labelIF" + "4" -> "LabelIF4")
-  static std::string newLabelIF();
-  static std::string newLabelWHILE();
-  static std::string newTEMP();
+  std::string newLabelIF();
+  std::string newLabelWHILE();
+  std::string newLabelCOND();
+  std::string newTEMP();
   
   // reset individual counters 
-  static void resetLabelIF();
-  static void resetLabelWHILE();
-  static void resetTEMP();
+  void resetLabelIF();
+  void resetLabelWHILE();
+  void resetLabelCOND();
+  void resetTEMP();
   
-  // reset label counters (IF and WHILE)
-  static void resetLabels();
-  // reset all counters (IF, WHILE, and TEMP)
-  static void reset();
+  // reset label counters (IF, WHILE and COND)
+  void resetLabels();
+  // reset all counters (IF, WHILE, COND and TEMP)
+  void reset();
 };